@@ -0,0 +1,225 @@
+// A small reduced ordered BDD package, used to represent points-to sets as
+// characteristic functions over the bits of dense object IDs. Nodes are
+// hash-consed, so sets with common structure share it. Variable 0 is the most
+// significant bit of an ID.
+
+#ifndef POINTS2_BDD_H
+#define POINTS2_BDD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class BDD {
+public:
+  using Ref = uint32_t;
+  // enumerators, so that C++14 needs no out-of-line definitions
+  enum : Ref { FALSE = 0, TRUE = 1 };
+
+  explicit BDD(unsigned nvars) : nvars(nvars) {
+    nodes.push_back({nvars, FALSE, FALSE});
+    nodes.push_back({nvars, TRUE, TRUE});
+    unique.assign(1 << 16, EMPTY);
+    cache.assign(1 << 16, {0, 0, 0, 0});
+  }
+
+  unsigned numVars() const { return nvars; }
+  size_t numNodes() const { return nodes.size(); }
+  size_t memorySize() const {
+    return nodes.capacity() * sizeof(Node) +
+           unique.capacity() * sizeof(Ref) +
+           cache.capacity() * sizeof(CacheEntry);
+  }
+
+  Ref unite(Ref a, Ref b) { return apply(OR, a, b); }
+  Ref intersect(Ref a, Ref b) { return apply(AND, a, b); }
+  Ref minus(Ref a, Ref b) { return apply(DIFF, a, b); }
+
+  // The set {id}.
+  Ref single(uint64_t id) {
+    Ref r = TRUE;
+    for (unsigned v = nvars; v-- > 0;) {
+      bool bit = (id >> (nvars - 1 - v)) & 1;
+      r = bit ? mk(v, FALSE, r) : mk(v, r, FALSE);
+    }
+    return r;
+  }
+
+  bool contains(Ref r, uint64_t id) const {
+    while (r > TRUE) {
+      const Node &n = nodes[r];
+      r = ((id >> (nvars - 1 - n.var)) & 1) ? n.hi : n.lo;
+    }
+    return r == TRUE;
+  }
+
+  // Calls fn(id) for every ID in the set, in increasing order.
+  template <typename Fn> void forEach(Ref r, Fn fn) const {
+    enumerate(r, 0, 0, fn);
+  }
+
+  // Drops every node not reachable from roots and compacts the node table.
+  // The roots are rewritten in place.
+  void gc(const std::vector<Ref *> &roots) {
+    std::vector<Ref> remap(nodes.size(), EMPTY);
+    remap[FALSE] = FALSE;
+    remap[TRUE] = TRUE;
+    std::vector<Ref> stack;
+    for (Ref *root : roots)
+      stack.push_back(*root);
+    while (!stack.empty()) {
+      Ref r = stack.back();
+      stack.pop_back();
+      if (remap[r] != EMPTY)
+        continue;
+      remap[r] = 0; // marked
+      stack.push_back(nodes[r].lo);
+      stack.push_back(nodes[r].hi);
+    }
+
+    // children always precede their parents, so one forward pass suffices
+    std::vector<Node> live = {nodes[FALSE], nodes[TRUE]};
+    for (Ref r = 2; r < nodes.size(); ++r) {
+      if (remap[r] == EMPTY)
+        continue;
+      remap[r] = live.size();
+      live.push_back({nodes[r].var, remap[nodes[r].lo], remap[nodes[r].hi]});
+    }
+    nodes.swap(live);
+    for (Ref *root : roots)
+      *root = remap[*root];
+
+    size_t size = unique.size();
+    while (size > (1 << 16) && nodes.size() * 4 < size)
+      size /= 2;
+    unique.assign(size, EMPTY);
+    for (Ref r = 2; r < nodes.size(); ++r)
+      unique[findSlot(nodes[r].var, nodes[r].lo, nodes[r].hi)] = r;
+    cache.assign(cache.size(), {0, 0, 0, 0});
+  }
+
+private:
+  enum Op : uint32_t { OR = 1, AND, DIFF };
+  enum : Ref { EMPTY = ~0u };
+
+  struct Node {
+    unsigned var;
+    Ref lo, hi;
+  };
+  struct CacheEntry {
+    uint32_t op;
+    Ref a, b, result;
+  };
+
+  unsigned nvars;
+  std::vector<Node> nodes;
+  std::vector<Ref> unique; // open addressing, indices into nodes
+  std::vector<CacheEntry> cache;
+
+  static uint64_t hash(uint64_t a, uint64_t b, uint64_t c) {
+    uint64_t h = a * 0x9E3779B97F4A7C15ull;
+    h ^= b + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+    h ^= c + 0x94D049BB133111EBull + (h << 6) + (h >> 2);
+    return h ^ (h >> 29);
+  }
+
+  size_t findSlot(unsigned var, Ref lo, Ref hi) const {
+    size_t mask = unique.size() - 1;
+    size_t i = hash(var, lo, hi) & mask;
+    while (unique[i] != EMPTY) {
+      const Node &n = nodes[unique[i]];
+      if (n.var == var && n.lo == lo && n.hi == hi)
+        break;
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  Ref mk(unsigned var, Ref lo, Ref hi) {
+    if (lo == hi)
+      return lo;
+    size_t i = findSlot(var, lo, hi);
+    if (unique[i] != EMPTY)
+      return unique[i];
+    Ref r = nodes.size();
+    nodes.push_back({var, lo, hi});
+    unique[i] = r;
+    if (nodes.size() * 2 > unique.size()) {
+      if (cache.size() < unique.size() && cache.size() < (1 << 22))
+        cache.assign(cache.size() * 2, {0, 0, 0, 0});
+      unique.assign(unique.size() * 2, EMPTY);
+      for (Ref n = 2; n < nodes.size(); ++n)
+        unique[findSlot(nodes[n].var, nodes[n].lo, nodes[n].hi)] = n;
+    }
+    return r;
+  }
+
+  Ref apply(Op op, Ref a, Ref b) {
+    switch (op) {
+    case OR:
+      if (a == TRUE || b == TRUE)
+        return TRUE;
+      if (a == FALSE || a == b)
+        return b;
+      if (b == FALSE)
+        return a;
+      if (a > b)
+        std::swap(a, b);
+      break;
+    case AND:
+      if (a == FALSE || b == FALSE)
+        return FALSE;
+      if (a == TRUE || a == b)
+        return b;
+      if (b == TRUE)
+        return a;
+      if (a > b)
+        std::swap(a, b);
+      break;
+    case DIFF:
+      if (a == FALSE || b == TRUE || a == b)
+        return FALSE;
+      if (b == FALSE)
+        return a;
+      break;
+    }
+
+    uint64_t h = hash(op, a, b);
+    const CacheEntry &entry = cache[h & (cache.size() - 1)];
+    if (entry.op == op && entry.a == a && entry.b == b)
+      return entry.result;
+
+    unsigned var = std::min(nodes[a].var, nodes[b].var);
+    Ref alo = nodes[a].var == var ? nodes[a].lo : a;
+    Ref ahi = nodes[a].var == var ? nodes[a].hi : a;
+    Ref blo = nodes[b].var == var ? nodes[b].lo : b;
+    Ref bhi = nodes[b].var == var ? nodes[b].hi : b;
+    Ref lo = apply(op, alo, blo);
+    Ref hi = apply(op, ahi, bhi);
+    Ref result = mk(var, lo, hi);
+    // mk may have grown the cache, so index it afresh
+    cache[h & (cache.size() - 1)] = {op, a, b, result};
+    return result;
+  }
+
+  template <typename Fn>
+  void enumerate(Ref r, unsigned level, uint64_t prefix, Fn &fn) const {
+    if (r == FALSE)
+      return;
+    if (level == nvars) {
+      fn(prefix);
+      return;
+    }
+    const Node &n = nodes[r];
+    if (n.var > level) {
+      enumerate(r, level + 1, prefix << 1, fn);
+      enumerate(r, level + 1, (prefix << 1) | 1, fn);
+    } else {
+      enumerate(n.lo, level + 1, prefix << 1, fn);
+      enumerate(n.hi, level + 1, (prefix << 1) | 1, fn);
+    }
+  }
+};
+
+#endif
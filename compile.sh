@@ -6,6 +6,18 @@
 
 clang++ -O3 p2.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core` -o p2
 
-clang++ -O3 p2.cpp -DCONCURRENT -DNTHREADS=4 -DPRINT_STATS `llvm-config --cxxflags --ldflags --system-libs --libs core` -o p2-c
+# ./p2 FILE --threads 4 --stats
+# ./p2 FILE --csv --warmup 1 --runs 10
+# ./p2 FILE --threads 4 --stats --func-time-budget 100000 --total-time-budget 60000000
+# ./p2 FILE --sweep --threads 16
+# ./p2 --batch DIR_OR_LIST --threads 16 --batch-out results.csv
+# ./p2 FILE --slice --stats
+# ./p2 FILE --print --query main:x
 
-clang++ -O3 p2.cpp -DCSV -DRUN_COUNT=3 `llvm-config --cxxflags --ldflags --system-libs --libs core` -o p2-csv
+clang++ -O3 p2-fit.cpp -o p2-fit
+
+clang++ -O3 p2-compare.cpp -o p2-compare
+
+clang++ -O3 p2-bench.cpp `llvm-config --cxxflags --ldflags --system-libs --libs support` -o p2-bench
+
+clang++ -O3 p2-replay.cpp `llvm-config --cxxflags --ldflags --system-libs --libs support` -o p2-replay
@@ -0,0 +1,562 @@
+// Microbenchmarks for the containers the solvers are built on. Every
+// candidate points-to set runs the same operation mixes -- the insert-range,
+// difference, contains and iteration steps that propagate() and solve()
+// perform -- and the worklist containers are compared on push/pop traffic.
+// Mixes are synthetic unless mix files are given on the command line.
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <malloc.h>
+#include <queue>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+#ifndef BENCH_REPS
+#define BENCH_REPS 5
+#endif
+
+// Elements are dense object IDs. Pointer-keyed containers see them as
+// addresses spaced like instructions; these are never dereferenced.
+inline void *addr(unsigned id) {
+  return reinterpret_cast<void *>(0x100000 + (uintptr_t)id * 64);
+}
+inline unsigned idOf(const void *p) {
+  return (reinterpret_cast<uintptr_t>(p) - 0x100000) / 64;
+}
+
+struct StdSet {
+  static constexpr const char *name = "std::set";
+  std::set<void *> s;
+
+  void clear() { s.clear(); }
+  void insert(unsigned id) { s.insert(addr(id)); }
+  void unite(const StdSet &o) { s.insert(o.s.begin(), o.s.end()); }
+  void assignDiff(const StdSet &a, const StdSet &b) {
+    s.clear();
+    std::set_difference(a.s.begin(), a.s.end(), b.s.begin(), b.s.end(),
+                        std::inserter(s, s.begin()));
+  }
+  bool contains(unsigned id) const { return s.count(addr(id)); }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (void *p : s)
+      fn(idOf(p));
+  }
+  size_t size() const { return s.size(); }
+};
+
+struct DenseSetBench {
+  static constexpr const char *name = "DenseSet";
+  DenseSet<void *> s;
+
+  void clear() { s.clear(); }
+  void insert(unsigned id) { s.insert(addr(id)); }
+  void unite(const DenseSetBench &o) { s.insert(o.s.begin(), o.s.end()); }
+  void assignDiff(const DenseSetBench &a, const DenseSetBench &b) {
+    s.clear();
+    for (void *p : a.s)
+      if (!b.s.contains(p))
+        s.insert(p);
+  }
+  bool contains(unsigned id) const { return s.contains(addr(id)); }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (void *p : s)
+      fn(idOf(p));
+  }
+  size_t size() const { return s.size(); }
+};
+
+struct SmallPtrSetBench {
+  static constexpr const char *name = "SmallPtrSet<16>";
+  SmallPtrSet<void *, 16> s;
+
+  void clear() { s.clear(); }
+  void insert(unsigned id) { s.insert(addr(id)); }
+  void unite(const SmallPtrSetBench &o) { s.insert(o.s.begin(), o.s.end()); }
+  void assignDiff(const SmallPtrSetBench &a, const SmallPtrSetBench &b) {
+    s.clear();
+    for (void *p : a.s)
+      if (!b.s.count(p))
+        s.insert(p);
+  }
+  bool contains(unsigned id) const { return s.count(addr(id)); }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (void *p : s)
+      fn(idOf(p));
+  }
+  size_t size() const { return s.size(); }
+};
+
+struct SparseBitVectorBench {
+  static constexpr const char *name = "SparseBitVector";
+  SparseBitVector<128> s;
+
+  void clear() { s.clear(); }
+  void insert(unsigned id) { s.set(id); }
+  void unite(const SparseBitVectorBench &o) { s |= o.s; }
+  void assignDiff(const SparseBitVectorBench &a,
+                  const SparseBitVectorBench &b) {
+    s.intersectWithComplement(a.s, b.s);
+  }
+  bool contains(unsigned id) const { return s.test(id); }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (unsigned id : s)
+      fn(id);
+  }
+  size_t size() const { return s.count(); }
+};
+
+struct SortedVector {
+  static constexpr const char *name = "sorted vector";
+  std::vector<unsigned> s;
+
+  void clear() { s.clear(); }
+  void insert(unsigned id) {
+    auto it = std::lower_bound(s.begin(), s.end(), id);
+    if (it == s.end() || *it != id)
+      s.insert(it, id);
+  }
+  void unite(const SortedVector &o) {
+    std::vector<unsigned> merged;
+    merged.reserve(s.size() + o.s.size());
+    std::set_union(s.begin(), s.end(), o.s.begin(), o.s.end(),
+                   std::back_inserter(merged));
+    s.swap(merged);
+  }
+  void assignDiff(const SortedVector &a, const SortedVector &b) {
+    s.clear();
+    std::set_difference(a.s.begin(), a.s.end(), b.s.begin(), b.s.end(),
+                        std::back_inserter(s));
+  }
+  bool contains(unsigned id) const {
+    return std::binary_search(s.begin(), s.end(), id);
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (unsigned id : s)
+      fn(id);
+  }
+  size_t size() const { return s.size(); }
+};
+
+struct Bitmap {
+  static constexpr const char *name = "bitmap";
+  std::vector<uint64_t> words;
+
+  void clear() { words.clear(); }
+  void insert(unsigned id) {
+    if (id / 64 >= words.size())
+      words.resize(id / 64 + 1, 0);
+    words[id / 64] |= 1ull << (id % 64);
+  }
+  void unite(const Bitmap &o) {
+    if (o.words.size() > words.size())
+      words.resize(o.words.size(), 0);
+    for (size_t i = 0; i < o.words.size(); ++i)
+      words[i] |= o.words[i];
+  }
+  void assignDiff(const Bitmap &a, const Bitmap &b) {
+    words = a.words;
+    size_t n = std::min(words.size(), b.words.size());
+    for (size_t i = 0; i < n; ++i)
+      words[i] &= ~b.words[i];
+  }
+  bool contains(unsigned id) const {
+    return id / 64 < words.size() && (words[id / 64] >> (id % 64)) & 1;
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (size_t i = 0; i < words.size(); ++i) {
+      for (uint64_t w = words[i]; w; w &= w - 1)
+        fn(i * 64 + __builtin_ctzll(w));
+    }
+  }
+  size_t size() const {
+    size_t n = 0;
+    for (uint64_t w : words)
+      n += __builtin_popcountll(w);
+    return n;
+  }
+};
+
+// An operation mix: a fixed sequence of operations over numbered sets.
+enum OpKind { CLEAR, INSERT, UNION, DIFF, CONTAINS, ITERATE };
+
+struct Op {
+  OpKind kind;
+  unsigned dst, a, b; // set indices; a/b are the operands of DIFF
+  unsigned elem;
+};
+
+struct Mix {
+  std::string name;
+  unsigned numSets = 0;
+  std::vector<Op> ops;
+};
+
+// Writes to a volatile sink so the optimizer keeps every lookup.
+volatile unsigned sink;
+
+template <class S> void runOps(const Mix &mix, std::vector<S> &sets) {
+  unsigned acc = 0;
+  for (const Op &op : mix.ops) {
+    switch (op.kind) {
+    case CLEAR:
+      sets[op.dst].clear();
+      break;
+    case INSERT:
+      sets[op.dst].insert(op.elem);
+      break;
+    case UNION:
+      sets[op.dst].unite(sets[op.a]);
+      break;
+    case DIFF:
+      if (op.dst == op.a || op.dst == op.b) {
+        S result;
+        result.assignDiff(sets[op.a], sets[op.b]);
+        sets[op.dst] = std::move(result);
+      } else {
+        sets[op.dst].assignDiff(sets[op.a], sets[op.b]);
+      }
+      break;
+    case CONTAINS:
+      acc += sets[op.dst].contains(op.elem);
+      break;
+    case ITERATE:
+      sets[op.dst].forEach([&](unsigned id) { acc += id; });
+      break;
+    }
+  }
+  sink = acc;
+}
+
+struct Result {
+  double nsPerOp;
+  double bytesPerElem;
+};
+
+// Heap bytes in use, malloc chunk overhead included, so that every container
+// is measured the same way rather than by a per-container formula.
+size_t heapInUse() {
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+}
+
+template <class S> Result benchSet(const Mix &mix) {
+  std::vector<double> times;
+  double bytesPerElem = 0;
+  times.reserve(BENCH_REPS);
+  for (int r = 0; r < BENCH_REPS; ++r) {
+    size_t heapBefore = heapInUse();
+    std::vector<S> sets(mix.numSets);
+    auto start = std::chrono::steady_clock::now();
+    runOps(mix, sets);
+    auto end = std::chrono::steady_clock::now();
+    size_t bytes = heapInUse() - heapBefore;
+    times.push_back(std::chrono::duration<double, std::nano>(end - start)
+                        .count() /
+                    std::max<size_t>(1, mix.ops.size()));
+    size_t elems = 0;
+    for (auto &s : sets)
+      elems += s.size();
+    bytesPerElem = elems ? (double)bytes / elems : 0;
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], bytesPerElem};
+}
+
+void report(const std::string &mix, const char *container, Result r) {
+  outs() << format("%-16s %-18s %12.1f %12.1f\n", mix.c_str(), container,
+                   r.nsPerOp, r.bytesPerElem);
+}
+
+void benchAllSets(const Mix &mix) {
+  report(mix.name, StdSet::name, benchSet<StdSet>(mix));
+  report(mix.name, DenseSetBench::name, benchSet<DenseSetBench>(mix));
+  report(mix.name, SmallPtrSetBench::name, benchSet<SmallPtrSetBench>(mix));
+  report(mix.name, SparseBitVectorBench::name,
+         benchSet<SparseBitVectorBench>(mix));
+  report(mix.name, SortedVector::name, benchSet<SortedVector>(mix));
+  report(mix.name, Bitmap::name, benchSet<Bitmap>(mix));
+}
+
+// Objects of one function get neighbouring IDs, and a pointer mostly points
+// into a few functions, so elements are drawn from a handful of clusters.
+struct ElemGen {
+  std::mt19937 rng;
+  unsigned universe;
+  std::vector<unsigned> clusters;
+
+  ElemGen(unsigned universe, unsigned seed) : rng(seed), universe(universe) {
+    for (int i = 0; i < 8; ++i)
+      clusters.push_back(rng() % universe);
+  }
+  unsigned next() {
+    unsigned base = clusters[rng() % clusters.size()];
+    return (base + rng() % 256) % universe;
+  }
+};
+
+// solve(): delta = incoming \ pt[n]; pt[n] |= delta; walk delta.
+Mix solveMix(unsigned nodes, unsigned steps, unsigned incomingSize) {
+  Mix mix;
+  mix.name = "solve";
+  const unsigned IN = nodes, DELTA = nodes + 1;
+  mix.numSets = nodes + 2;
+  ElemGen gen(1 << 16, 1);
+  std::mt19937 rng(2);
+  for (unsigned s = 0; s < steps; ++s) {
+    unsigned n = rng() % nodes;
+    mix.ops.push_back({CLEAR, IN, 0, 0, 0});
+    for (unsigned i = 0; i < incomingSize; ++i)
+      mix.ops.push_back({INSERT, IN, 0, 0, gen.next()});
+    mix.ops.push_back({DIFF, DELTA, IN, n, 0});
+    mix.ops.push_back({UNION, n, DELTA, 0, 0});
+    mix.ops.push_back({ITERATE, DELTA, 0, 0, 0});
+  }
+  return mix;
+}
+
+// propagate(): large, overlapping insert-ranges along PFG edges.
+Mix insertRangeMix(unsigned nodes, unsigned seedSize, unsigned steps) {
+  Mix mix;
+  mix.name = "insert-range";
+  mix.numSets = nodes;
+  ElemGen gen(1 << 16, 3);
+  std::mt19937 rng(4);
+  for (unsigned n = 0; n < nodes; ++n)
+    for (unsigned i = 0; i < seedSize; ++i)
+      mix.ops.push_back({INSERT, n, 0, 0, gen.next()});
+  for (unsigned s = 0; s < steps; ++s)
+    mix.ops.push_back(
+        {UNION, unsigned(rng() % nodes), unsigned(rng() % nodes), 0, 0});
+  return mix;
+}
+
+Mix containsMix(unsigned nodes, unsigned setSize, unsigned probes) {
+  Mix mix;
+  mix.name = "contains";
+  mix.numSets = nodes;
+  ElemGen gen(1 << 16, 5);
+  std::mt19937 rng(6);
+  for (unsigned n = 0; n < nodes; ++n)
+    for (unsigned i = 0; i < setSize; ++i)
+      mix.ops.push_back({INSERT, n, 0, 0, gen.next()});
+  for (unsigned p = 0; p < probes; ++p)
+    mix.ops.push_back({CONTAINS, unsigned(rng() % nodes), 0, 0, gen.next()});
+  return mix;
+}
+
+Mix iterateMix(unsigned nodes, unsigned setSize, unsigned walks) {
+  Mix mix;
+  mix.name = "iterate";
+  mix.numSets = nodes;
+  ElemGen gen(1 << 16, 7);
+  std::mt19937 rng(8);
+  for (unsigned n = 0; n < nodes; ++n)
+    for (unsigned i = 0; i < setSize; ++i)
+      mix.ops.push_back({INSERT, n, 0, 0, gen.next()});
+  for (unsigned w = 0; w < walks; ++w)
+    mix.ops.push_back({ITERATE, unsigned(rng() % nodes), 0, 0, 0});
+  return mix;
+}
+
+// Mix files are text files with one operation per line:
+//   i <set> <elem>    insert
+//   u <dst> <src>     dst |= src
+//   d <dst> <a> <b>   dst = a \ b
+//   c <set> <elem>    contains
+//   t <set>           iterate
+//   x <set>           clear
+// Lines starting with '#' are ignored.
+bool readMix(const char *filename, Mix &mix) {
+  std::ifstream in(filename);
+  if (!in)
+    return false;
+  mix.name = filename;
+  size_t slash = mix.name.find_last_of('/');
+  if (slash != std::string::npos)
+    mix.name = mix.name.substr(slash + 1);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream ss(line);
+    char kind;
+    Op op = {CLEAR, 0, 0, 0, 0};
+    ss >> kind;
+    switch (kind) {
+    case 'i':
+      op.kind = INSERT;
+      ss >> op.dst >> op.elem;
+      break;
+    case 'u':
+      op.kind = UNION;
+      ss >> op.dst >> op.a;
+      break;
+    case 'd':
+      op.kind = DIFF;
+      ss >> op.dst >> op.a >> op.b;
+      break;
+    case 'c':
+      op.kind = CONTAINS;
+      ss >> op.dst >> op.elem;
+      break;
+    case 't':
+      op.kind = ITERATE;
+      ss >> op.dst;
+      break;
+    case 'x':
+      op.kind = CLEAR;
+      ss >> op.dst;
+      break;
+    default:
+      return false;
+    }
+    if (!ss)
+      return false;
+    mix.numSets = std::max({mix.numSets, op.dst + 1, op.a + 1, op.b + 1});
+    mix.ops.push_back(op);
+  }
+  return true;
+}
+
+// Worklists: the FIFO of (node, set) pairs p2.cpp uses against the WLMap
+// that merges pending sets per node, as in p2-inter-dense.cpp.
+struct WorklistResult {
+  double nsPerPush;
+  size_t pops;
+  double peakBytes;
+};
+
+template <typename Push, typename Pop, typename Bytes>
+WorklistResult benchWorklist(unsigned keys, unsigned pushes, unsigned setSize,
+                             Push push, Pop pop, Bytes bytes) {
+  ElemGen gen(1 << 16, 9);
+  std::mt19937 rng(10);
+  std::vector<std::pair<void *, DenseSet<void *>>> items(pushes);
+  for (auto &[key, set] : items) {
+    key = addr(rng() % keys);
+    for (unsigned i = 0; i < setSize; ++i)
+      set.insert(addr(gen.next()));
+  }
+
+  // interleave pushes and pops like the solver: a pop every other push
+  size_t pops = 0, peak = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < pushes; ++i) {
+    push(items[i].first, items[i].second);
+    if (i % 2)
+      pops += pop();
+    if (i % 1024 == 0)
+      peak = std::max(peak, bytes());
+  }
+  peak = std::max(peak, bytes());
+  size_t n;
+  while ((n = pop()))
+    pops += n;
+  auto end = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double, std::nano>(end - start).count() /
+              pushes,
+          pops, (double)peak};
+}
+
+const char *StdQueueName = "std::queue";
+const char *WLMapName = "WLMap";
+
+void benchWorklists(unsigned keys, unsigned pushes, unsigned setSize) {
+  outs() << "\nWorklist: " << pushes << " pushes over " << keys
+         << " node(s), " << setSize << " element(s) each\n";
+  outs() << left_justify("container", 18) << right_justify("ns/push", 13)
+         << right_justify("pops", 13) << right_justify("peak bytes", 15)
+         << "\n";
+
+  {
+    std::queue<std::pair<void *, DenseSet<void *>>> worklist;
+    size_t setBytes = 0;
+    auto r = benchWorklist(
+        keys, pushes, setSize,
+        [&](void *key, const DenseSet<void *> &set) {
+          worklist.push({key, set});
+          setBytes += sizeof(worklist.back()) + set.getMemorySize();
+        },
+        [&]() -> size_t {
+          if (worklist.empty())
+            return 0;
+          setBytes -= sizeof(worklist.front()) +
+                      worklist.front().second.getMemorySize();
+          worklist.pop();
+          return 1;
+        },
+        [&]() { return setBytes; });
+    outs() << format("%-18s %12.1f %12zu %14.0f\n", StdQueueName, r.nsPerPush,
+                     r.pops, r.peakBytes);
+  }
+
+  {
+    DenseMap<void *, DenseSet<void *>> WLMap;
+    auto r = benchWorklist(
+        keys, pushes, setSize,
+        [&](void *key, const DenseSet<void *> &set) {
+          auto it = WLMap.find(key);
+          if (it != WLMap.end())
+            it->second.insert(set.begin(), set.end());
+          else
+            WLMap[key] = set;
+        },
+        [&]() -> size_t {
+          if (WLMap.empty())
+            return 0;
+          WLMap.erase(WLMap.begin());
+          return 1;
+        },
+        [&]() {
+          size_t b = WLMap.getMemorySize();
+          for (auto &[key, set] : WLMap)
+            b += set.getMemorySize();
+          return b;
+        });
+    outs() << format("%-18s %12.1f %12zu %14.0f\n", WLMapName, r.nsPerPush,
+                     r.pops, r.peakBytes);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<Mix> mixes;
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      Mix mix;
+      if (!readMix(argv[i], mix)) {
+        errs() << "Cannot read mix file " << argv[i] << "\n";
+        exit(1);
+      }
+      mixes.push_back(std::move(mix));
+    }
+  } else {
+    mixes.push_back(solveMix(2000, 20000, 16));
+    mixes.push_back(insertRangeMix(500, 200, 5000));
+    mixes.push_back(containsMix(500, 200, 1000000));
+    mixes.push_back(iterateMix(500, 200, 20000));
+  }
+
+  outs() << left_justify("mix", 17) << left_justify("container", 18)
+         << right_justify("ns/op", 13) << right_justify("bytes/elem", 13)
+         << "\n";
+  for (auto &mix : mixes)
+    benchAllSets(mix);
+
+  if (argc <= 1) {
+    benchWorklists(1000, 200000, 8);
+    benchWorklists(100000, 200000, 8);
+  }
+}
@@ -0,0 +1,227 @@
+// Compares two CSV files written by p2 --csv with --runs > 1 and marks the
+// functions whose init, solve or total time changed significantly. Each
+// function and phase is tested with Welch's t-test on the recorded mean, sd
+// and run count. The p-values are corrected for the number of tests with
+// Benjamini-Hochberg, and a change also has to move the median by at least
+// the threshold. The exit status is 1 if any regression was found.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const char *phases[] = {"init", "solve", "total"};
+
+struct PhaseStats {
+  double median = 0, mean = 0, sd = 0;
+};
+
+struct Row {
+  bool degraded = false;
+  int runs = 0;
+  PhaseStats phase[3];
+  std::vector<std::string> ops;
+};
+
+std::vector<std::string> splitCSV(const std::string &line) {
+  std::vector<std::string> cells;
+  std::stringstream ss(line);
+  std::string cell;
+  while (std::getline(ss, cell, ','))
+    cells.push_back(cell);
+  return cells;
+}
+
+bool readCSV(const char *filename, std::map<std::string, Row> &rows) {
+  std::ifstream in(filename);
+  std::string line;
+  if (!in || !std::getline(in, line))
+    return false;
+
+  auto header = splitCSV(line);
+  auto column = [&](const std::string &name) {
+    auto it = std::find(header.begin(), header.end(), name);
+    return it == header.end() ? -1 : (int)(it - header.begin());
+  };
+  int nameCol = column("name"), degradedCol = column("degraded");
+  int runsCol = column("runs");
+  int statCols[3][3];
+  for (int p = 0; p < 3; ++p) {
+    std::string prefix = phases[p];
+    statCols[p][0] = column(prefix + "_median(us)");
+    statCols[p][1] = column(prefix + "_mean(us)");
+    statCols[p][2] = column(prefix + "_sd(us)");
+    for (int c : statCols[p])
+      if (c < 0)
+        return false;
+  }
+  if (nameCol < 0 || runsCol < 0)
+    return false;
+  std::vector<int> opCols;
+  for (int c = 0; c < (int)header.size(); ++c)
+    if (header[c].rfind("ops_", 0) == 0)
+      opCols.push_back(c);
+
+  while (std::getline(in, line)) {
+    auto cells = splitCSV(line);
+    if (cells.size() != header.size())
+      continue;
+    Row row;
+    row.degraded = degradedCol >= 0 && cells[degradedCol] != "0";
+    row.runs = std::stoi(cells[runsCol]);
+    for (int p = 0; p < 3; ++p) {
+      row.phase[p].median = std::stod(cells[statCols[p][0]]);
+      row.phase[p].mean = std::stod(cells[statCols[p][1]]);
+      row.phase[p].sd = std::stod(cells[statCols[p][2]]);
+    }
+    for (int c : opCols)
+      row.ops.push_back(cells[c]);
+    rows[cells[nameCol]] = row;
+  }
+  return true;
+}
+
+// Regularized incomplete beta function I_x(a, b), by Lentz's continued
+// fraction.
+double incompleteBeta(double a, double b, double x) {
+  if (x <= 0)
+    return 0;
+  if (x >= 1)
+    return 1;
+  if (x > (a + 1) / (a + b + 2))
+    return 1 - incompleteBeta(b, a, 1 - x);
+  const double tiny = 1e-300;
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+                          std::lgamma(b) + a * std::log(x) +
+                          b * std::log(1 - x)) /
+                 a;
+  double f = 1, c = 1, d = 0;
+  for (int i = 0; i <= 200; ++i) {
+    int m = i / 2;
+    double num;
+    if (i == 0)
+      num = 1;
+    else if (i % 2 == 0)
+      num = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+    else
+      num = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+    d = 1 + num * d;
+    d = 1 / (std::abs(d) < tiny ? tiny : d);
+    c = 1 + num / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    f *= c * d;
+    if (std::abs(1 - c * d) < 1e-12)
+      break;
+  }
+  return front * (f - 1);
+}
+
+// Two-sided p-value of Welch's t-test.
+double welchTest(const PhaseStats &a, int na, const PhaseStats &b, int nb) {
+  double va = a.sd * a.sd / na, vb = b.sd * b.sd / nb;
+  if (va + vb == 0)
+    return a.mean == b.mean ? 1 : 0;
+  double t = (b.mean - a.mean) / std::sqrt(va + vb);
+  double df = (va + vb) * (va + vb) /
+              (va * va / (na - 1) + vb * vb / (nb - 1));
+  return incompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+struct Test {
+  std::string name;
+  int phase;
+  double before, after; // medians
+  double p;
+};
+
+int main(int argc, char *argv[]) {
+  double alpha = 0.05, threshold = 5;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--alpha" && i + 1 < argc)
+      alpha = std::stod(argv[++i]);
+    else if (arg == "--threshold" && i + 1 < argc)
+      threshold = std::stod(argv[++i]);
+    else
+      files.push_back(argv[i]);
+  }
+  if (files.size() != 2) {
+    std::cerr << "Usage: p2-compare [--alpha A] [--threshold PCT] OLD.csv "
+                 "NEW.csv\n";
+    return 1;
+  }
+  std::map<std::string, Row> before, after;
+  for (int f = 0; f < 2; ++f) {
+    if (!readCSV(files[f], f ? after : before)) {
+      std::cerr << "Cannot read CSV file " << files[f]
+                << " (expect the columns of p2 --csv)\n";
+      return 1;
+    }
+  }
+
+  std::vector<Test> tests;
+  int compared = 0, untested = 0, opsChanged = 0;
+  double logRatio[3] = {0, 0, 0};
+  for (auto &[name, a] : before) {
+    auto it = after.find(name);
+    if (it == after.end() || a.degraded || it->second.degraded)
+      continue;
+    auto &b = it->second;
+    compared++;
+    opsChanged += a.ops != b.ops;
+    for (int p = 0; p < 3; ++p) {
+      // clamp at 1 us so that empty functions do not blow up the mean
+      logRatio[p] += std::log(std::max(b.phase[p].median, 1.0) /
+                              std::max(a.phase[p].median, 1.0));
+      if (a.runs < 2 || b.runs < 2) {
+        untested++;
+        continue;
+      }
+      tests.push_back({name, p, a.phase[p].median, b.phase[p].median,
+                       welchTest(a.phase[p], a.runs, b.phase[p], b.runs)});
+    }
+  }
+  if (compared == 0) {
+    std::cerr << "No common non-degraded functions\n";
+    return 1;
+  }
+
+  // Benjamini-Hochberg: reject the k smallest p-values, for the largest k
+  // with p_(k) <= k / m * alpha.
+  std::sort(tests.begin(), tests.end(),
+            [](const Test &x, const Test &y) { return x.p < y.p; });
+  size_t rejected = 0;
+  for (size_t k = 1; k <= tests.size(); ++k)
+    if (tests[k - 1].p <= alpha * k / tests.size())
+      rejected = k;
+
+  int regressions = 0, improvements = 0;
+  for (size_t k = 0; k < rejected; ++k) {
+    auto &t = tests[k];
+    double change = 100 * (t.after - t.before) / std::max(t.before, 1.0);
+    if (std::abs(change) < threshold)
+      continue;
+    bool worse = change > 0;
+    (worse ? regressions : improvements)++;
+    printf("%-11s %-5s %10.1f -> %10.1f us  %+7.1f%%  p=%.2g  %s\n",
+           worse ? "REGRESSION" : "improvement", phases[t.phase], t.before,
+           t.after, change, t.p, t.name.c_str());
+  }
+
+  printf("\n%d function(s) compared, %d regression(s), %d improvement(s)\n",
+         compared, regressions, improvements);
+  if (untested)
+    printf("%d comparison(s) not tested: fewer than 2 runs\n", untested);
+  if (opsChanged)
+    printf("%d function(s) changed their set operation counts\n", opsChanged);
+  for (int p = 0; p < 3; ++p)
+    printf("Geometric mean %s median ratio: %.3f\n", phases[p],
+           std::exp(logRatio[p] / compared));
+  return regressions ? 1 : 0;
+}
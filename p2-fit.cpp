@@ -0,0 +1,223 @@
+// Fits the cost model used by the concurrent scheduler of p2 from the CSV
+// files written by p2 --csv. Every column other than name, time(us),
+// degraded and the repeated-run measurements is a feature; the model is
+// printed as "<feature> <coefficient>" lines, ready to pass to p2 --model.
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Dataset {
+  std::vector<std::string> features;
+  std::vector<std::vector<double>> X;
+  std::vector<double> y;
+};
+
+std::vector<std::string> splitCSV(const std::string &line) {
+  std::vector<std::string> cells;
+  std::stringstream ss(line);
+  std::string cell;
+  while (std::getline(ss, cell, ','))
+    cells.push_back(cell);
+  return cells;
+}
+
+// Timing statistics and operation counts are outcomes, not features.
+bool isMeasurement(const std::string &column) {
+  auto endsWith = [&](const std::string &suffix) {
+    return column.size() >= suffix.size() &&
+           column.compare(column.size() - suffix.size(), suffix.size(),
+                          suffix) == 0;
+  };
+  return column == "runs" || column.rfind("ops_", 0) == 0 || endsWith("(us)");
+}
+
+bool readCSV(const char *filename, Dataset &data) {
+  std::ifstream in(filename);
+  std::string line;
+  if (!in || !std::getline(in, line))
+    return false;
+
+  auto header = splitCSV(line);
+  int timeCol = -1, degradedCol = -1;
+  std::vector<int> featureCols;
+  std::vector<std::string> names;
+  for (int c = 0; c < (int)header.size(); ++c) {
+    if (header[c] == "time(us)")
+      timeCol = c;
+    else if (header[c] == "degraded")
+      degradedCol = c;
+    else if (header[c] != "name" && !isMeasurement(header[c])) {
+      featureCols.push_back(c);
+      names.push_back(header[c]);
+    }
+  }
+  if (timeCol < 0)
+    return false;
+  if (data.features.empty())
+    data.features = names;
+  else if (data.features != names)
+    return false;
+
+  while (std::getline(in, line)) {
+    auto cells = splitCSV(line);
+    if (cells.size() != header.size())
+      continue;
+    // budget-limited runs do not reflect the real solve time
+    if (degradedCol >= 0 && cells[degradedCol] != "0")
+      continue;
+    std::vector<double> row;
+    for (int c : featureCols)
+      row.push_back(std::stod(cells[c]));
+    data.X.push_back(row);
+    data.y.push_back(std::stod(cells[timeCol]));
+  }
+  return true;
+}
+
+// Solves A x = b by Gaussian elimination with partial pivoting.
+std::vector<double> solveLinear(std::vector<std::vector<double>> A,
+                                std::vector<double> b) {
+  int n = b.size();
+  for (int k = 0; k < n; ++k) {
+    int pivot = k;
+    for (int i = k + 1; i < n; ++i)
+      if (std::abs(A[i][k]) > std::abs(A[pivot][k]))
+        pivot = i;
+    std::swap(A[k], A[pivot]);
+    std::swap(b[k], b[pivot]);
+    for (int i = k + 1; i < n; ++i) {
+      double m = A[i][k] / A[k][k];
+      for (int j = k; j < n; ++j)
+        A[i][j] -= m * A[k][j];
+      b[i] -= m * b[k];
+    }
+  }
+  std::vector<double> x(n);
+  for (int i = n - 1; i >= 0; --i) {
+    double sum = b[i];
+    for (int j = i + 1; j < n; ++j)
+      sum -= A[i][j] * x[j];
+    x[i] = sum / A[i][i];
+  }
+  return x;
+}
+
+// Ridge regression on standardized features. Only features with used[j] set
+// take part; the rest get a zero coefficient. Returns {intercept, coef...}.
+std::vector<double> fit(const Dataset &data, const std::vector<bool> &used) {
+  const double lambda = 1e-6;
+  size_t n = data.y.size(), k = data.features.size();
+  std::vector<double> mean(k, 0), sd(k, 0);
+  double ymean = 0;
+  for (size_t r = 0; r < n; ++r) {
+    ymean += data.y[r] / n;
+    for (size_t j = 0; j < k; ++j)
+      mean[j] += data.X[r][j] / n;
+  }
+  for (size_t r = 0; r < n; ++r)
+    for (size_t j = 0; j < k; ++j)
+      sd[j] += (data.X[r][j] - mean[j]) * (data.X[r][j] - mean[j]) / n;
+
+  std::vector<int> cols;
+  for (size_t j = 0; j < k; ++j) {
+    sd[j] = std::sqrt(sd[j]);
+    // constant columns only carry rounding noise
+    if (used[j] && sd[j] > 1e-9 * (std::abs(mean[j]) + 1))
+      cols.push_back(j);
+  }
+
+  size_t m = cols.size();
+  std::vector<std::vector<double>> A(m, std::vector<double>(m, 0));
+  std::vector<double> b(m, 0);
+  for (size_t r = 0; r < n; ++r) {
+    for (size_t p = 0; p < m; ++p) {
+      double zp = (data.X[r][cols[p]] - mean[cols[p]]) / sd[cols[p]];
+      b[p] += zp * (data.y[r] - ymean);
+      for (size_t q = 0; q < m; ++q)
+        A[p][q] += zp * (data.X[r][cols[q]] - mean[cols[q]]) / sd[cols[q]];
+    }
+  }
+  for (size_t p = 0; p < m; ++p)
+    A[p][p] += lambda * n;
+
+  std::vector<double> model(k + 1, 0);
+  model[0] = ymean;
+  if (m == 0)
+    return model;
+  auto beta = solveLinear(A, b);
+  for (size_t p = 0; p < m; ++p) {
+    model[cols[p] + 1] = beta[p] / sd[cols[p]];
+    model[0] -= model[cols[p] + 1] * mean[cols[p]];
+  }
+  return model;
+}
+
+// Refits without any feature that came out negative, so that a function
+// never gets cheaper by growing.
+std::vector<double> fitNonNegative(const Dataset &data,
+                                   std::vector<bool> used) {
+  while (true) {
+    auto model = fit(data, used);
+    bool changed = false;
+    for (size_t j = 0; j < used.size(); ++j) {
+      if (used[j] && model[j + 1] < 0) {
+        used[j] = false;
+        changed = true;
+      }
+    }
+    if (!changed)
+      return model;
+  }
+}
+
+double rSquared(const Dataset &data, const std::vector<double> &model) {
+  double ymean = 0;
+  for (double y : data.y)
+    ymean += y / data.y.size();
+  double ssRes = 0, ssTot = 0;
+  for (size_t r = 0; r < data.y.size(); ++r) {
+    double pred = model[0];
+    for (size_t j = 0; j < data.features.size(); ++j)
+      pred += model[j + 1] * data.X[r][j];
+    ssRes += (data.y[r] - pred) * (data.y[r] - pred);
+    ssTot += (data.y[r] - ymean) * (data.y[r] - ymean);
+  }
+  return ssTot > 0 ? 1 - ssRes / ssTot : 1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Expect CSV filename(s)\n";
+    return 1;
+  }
+  Dataset data;
+  for (int i = 1; i < argc; ++i) {
+    if (!readCSV(argv[i], data)) {
+      std::cerr << "Cannot read CSV file " << argv[i] << "\n";
+      return 1;
+    }
+  }
+  if (data.y.empty()) {
+    std::cerr << "No samples\n";
+    return 1;
+  }
+
+  size_t k = data.features.size();
+  auto model = fitNonNegative(data, std::vector<bool>(k, true));
+  std::vector<bool> sizeOnly(k, false);
+  for (size_t j = 0; j < k; ++j)
+    sizeOnly[j] = data.features[j] == "size";
+  auto baseline = fitNonNegative(data, sizeOnly);
+
+  std::cerr << data.y.size() << " sample(s)\n";
+  std::cerr << "R^2 with all features:\t" << rSquared(data, model) << "\n";
+  std::cerr << "R^2 with BB count only:\t" << rSquared(data, baseline) << "\n";
+
+  std::cout << "intercept " << model[0] << "\n";
+  for (size_t j = 0; j < k; ++j)
+    std::cout << data.features[j] << " " << model[j + 1] << "\n";
+}
@@ -1,6 +1,10 @@
+#include "bdd.h"
+#include "trace.h"
+
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
@@ -10,45 +14,470 @@
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <queue>
 #include <set>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <unistd.h>
 
 using namespace llvm;
 
-std::unordered_map<Value *, DenseSet<Value *>> pt;
-// std::queue<std::pair<Value *, DenseSet<Value *>>> worklist;
-DenseMap<Value *, DenseSet<Value *>> WLMap;
+// Points-to sets are either hash sets or BDDs over dense object IDs; the
+// backend is chosen at startup with --bdd.
+std::unique_ptr<BDD> bdd;
+DenseMap<Value *, unsigned> objectId;
+std::vector<Value *> objects;
+
+unsigned getObjectId(Value *v) {
+  auto [it, inserted] = objectId.try_emplace(v, objects.size());
+  if (inserted)
+    objects.push_back(v);
+  return it->second;
+}
+
+struct PtsSet {
+  DenseSet<Value *> set;
+  BDD::Ref ref = BDD::FALSE;
+
+  PtsSet() = default;
+  PtsSet(Value *v) {
+    if (bdd)
+      ref = bdd->single(getObjectId(v));
+    else
+      set.insert(v);
+  }
+
+  bool empty() const { return bdd ? ref == BDD::FALSE : set.empty(); }
+
+  size_t size() const {
+    if (!bdd)
+      return set.size();
+    size_t n = 0;
+    bdd->forEach(ref, [&](uint64_t) { n++; });
+    return n;
+  }
+
+  bool contains(Value *v) const {
+    if (!bdd)
+      return set.contains(v);
+    auto it = objectId.find(v);
+    return it != objectId.end() && bdd->contains(ref, it->second);
+  }
+
+  void insert(const PtsSet &other) {
+    if (bdd)
+      ref = bdd->unite(ref, other.ref);
+    else
+      set.insert(other.set.begin(), other.set.end());
+  }
+
+  PtsSet minus(const PtsSet &other) const {
+    PtsSet result;
+    if (bdd) {
+      result.ref = bdd->minus(ref, other.ref);
+    } else {
+      for (auto &i : set) {
+        if (!other.set.contains(i)) {
+          result.set.insert(i);
+        }
+      }
+    }
+    return result;
+  }
+
+  template <typename Fn> void forEach(Fn fn) const {
+    if (bdd)
+      bdd->forEach(ref, [&](uint64_t id) { fn(objects[id]); });
+    else
+      for (Value *v : set)
+        fn(v);
+  }
+};
+
+std::unordered_map<Value *, PtsSet> pt;
+// std::queue<std::pair<Value *, PtsSet>> worklist;
+DenseMap<Value *, PtsSet> WLMap;
 std::unordered_map<Value *, DenseSet<Value *>> PFG;
 std::unordered_set<Value *> RM;
 
-void worklistPush(Value *key, const DenseSet<Value *> &sset) {
+// Nodes left after the last collection; the next one runs at twice that.
+size_t bddGCThreshold = 1 << 20;
+
+void collectGarbage() {
+  std::vector<BDD::Ref *> roots;
+  roots.reserve(pt.size() + WLMap.size());
+  for (auto &[n, pts] : pt)
+    roots.push_back(&pts.ref);
+  for (auto &[n, pts] : WLMap)
+    roots.push_back(&pts.ref);
+  bdd->gc(roots);
+  bddGCThreshold = std::max(bddGCThreshold, 2 * bdd->numNodes());
+}
+
+// Values are numbered in a fixed walk over the module, so the numbers are
+// stable across runs on the same module: globals, functions, arguments and
+// instructions first, then any other operand as it is met. Checkpoints and
+// traces refer to values by these numbers.
+DenseMap<Value *, uint64_t> stableId;
+std::vector<Value *> byStableId;
+uint64_t moduleFingerprint = 0;
+
+void numberValue(Value *v) {
+  if (stableId.try_emplace(v, byStableId.size()).second)
+    byStableId.push_back(v);
+}
+
+void numberValues(Module &module) {
+  for (auto &global : module.globals())
+    numberValue(&global);
+  for (auto &func : module) {
+    numberValue(&func);
+    for (auto &arg : func.args())
+      numberValue(&arg);
+    for (auto &BB : func)
+      for (auto &inst : BB)
+        numberValue(&inst);
+  }
+  for (auto &func : module)
+    for (auto &BB : func)
+      for (auto &inst : BB)
+        for (Value *op : inst.operands())
+          numberValue(op);
+
+  // FNV-1a over the function names and sizes
+  uint64_t h = 1469598103934665603ull;
+  auto mix = [&](uint64_t x) { h = (h ^ x) * 1099511628211ull; };
+  mix(byStableId.size());
+  for (auto &func : module) {
+    for (char c : func.getName())
+      mix(c);
+    for (auto &BB : func)
+      mix(BB.size());
+  }
+  moduleFingerprint = h;
+}
+
+// Event tracing (--trace FILE). Events collect in a flat 64K-event buffer,
+// not a ring: when it fills up, the solver thread itself appends it to the
+// file with fwrite and then starts over. See trace.h for the format.
+FILE *traceOut = nullptr;
+std::vector<TraceEvent> traceBuffer;
+size_t traceUsed = 0;
+bool solving = false;
+DenseSet<Value *> tracedUsers; // loads/stores already emitted
+
+void traceFlush() {
+  fwrite(traceBuffer.data(), sizeof(TraceEvent), traceUsed, traceOut);
+  traceUsed = 0;
+}
+
+// Fits in 32 bits: --trace rejects larger modules.
+inline uint32_t traceId(Value *v) { return (uint32_t)stableId.lookup(v); }
+
+// Callers check traceOut first so that disabled tracing costs one branch.
+inline void trace(TraceKind kind, uint32_t a, uint32_t b, uint32_t n = 0) {
+  traceBuffer[traceUsed++] = {kind, a, b, n};
+  if (traceUsed == traceBuffer.size())
+    traceFlush();
+}
+
+// Set sizes for trace events; with --bdd only whether the set is empty.
+inline uint32_t traceSize(const PtsSet &pts) {
+  if (bdd)
+    return pts.empty() ? 0 : TRACE_NO_SIZE;
+  return (uint32_t)pts.size();
+}
+
+// Varint encoding, shared by frozen points-to sets and checkpoints.
+void putVarint(std::string &out, uint64_t x) {
+  while (x >= 0x80) {
+    out.push_back((char)(x | 0x80));
+    x >>= 7;
+  }
+  out.push_back((char)x);
+}
+
+uint64_t getVarint(const char *&p) {
+  uint64_t x = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char c = *p++;
+    x |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return x;
+  }
+}
+
+// Memory budget (--mem-budget MB). The solver keeps an estimate of the
+// memory held by pt, PFG, the pending worklist sets and the object IDs; when
+// it passes the budget, the least recently used points-to sets in pt are
+// frozen into sorted, delta-encoded object ID lists.
+// If freezing is not enough, the coldest frozen sets are spilled to a file.
+// A frozen set is thawed back into a hash set on its next use. The space of
+// thawed sets is reclaimed by compacting the spill file once it holds more
+// dead bytes than live ones. Only pt is reduced: PFG and the worklist are
+// counted against the budget but never frozen or spilled, so a run whose
+// graph alone exceeds the budget stays over it.
+struct FrozenSet {
+  std::string packed; // empty once spilled
+  uint64_t offset = 0;
+  uint32_t bytes = 0;
+  bool spilled = false;
+};
+
+struct MemStats {
+  size_t peak = 0;
+  size_t freezes = 0, thaws = 0;
+  size_t spills = 0, spillReads = 0, compactions = 0;
+  uint64_t bytesWritten = 0, bytesRead = 0, spillPeak = 0;
+  std::chrono::steady_clock::duration time{};
+};
+
+size_t memBudget = 0;
+size_t hotBytes = 0, frozenBytes = 0, pfgBytes = 0, pendingBytes = 0;
+DenseMap<Value *, FrozenSet> frozen;
+DenseMap<Value *, uint64_t> lastUse;
+uint64_t useClock = 0; // worklist pops so far
+int spillFd = -1;
+SmallString<128> spillPath;
+uint64_t spillEnd = 0, spillLive = 0;
+MemStats memStats;
+
+size_t memUsage() {
+  // hash map nodes of pt and PFG
+  const size_t entry = sizeof(PtsSet) + sizeof(DenseSet<Value *>) +
+                       4 * sizeof(void *);
+  return hotBytes + frozenBytes + pfgBytes + pendingBytes +
+         (pt.size() + PFG.size()) * entry + WLMap.getMemorySize() +
+         frozen.getMemorySize() + lastUse.getMemorySize() +
+         objectId.getMemorySize() + objects.capacity() * sizeof(Value *);
+}
+
+void freeze(Value *n, PtsSet &pts) {
+  std::vector<uint32_t> ids;
+  ids.reserve(pts.set.size());
+  for (Value *v : pts.set)
+    ids.push_back(getObjectId(v));
+  std::sort(ids.begin(), ids.end());
+  FrozenSet &fs = frozen[n];
+  putVarint(fs.packed, ids.size());
+  uint32_t prev = 0;
+  for (uint32_t id : ids) {
+    putVarint(fs.packed, id - prev);
+    prev = id;
+  }
+  fs.packed.shrink_to_fit();
+  fs.bytes = fs.packed.size();
+  frozenBytes += fs.packed.capacity();
+  hotBytes -= pts.set.getMemorySize();
+  pts.set = DenseSet<Value *>();
+  memStats.freezes++;
+}
+
+bool spill(FrozenSet &fs) {
+  if (pwrite(spillFd, fs.packed.data(), fs.bytes, spillEnd) != fs.bytes)
+    return false;
+  fs.offset = spillEnd;
+  fs.spilled = true;
+  spillEnd += fs.bytes;
+  spillLive += fs.bytes;
+  memStats.spillPeak = std::max(memStats.spillPeak, spillEnd);
+  frozenBytes -= fs.packed.capacity();
+  std::string().swap(fs.packed);
+  memStats.spills++;
+  memStats.bytesWritten += fs.bytes;
+  return true;
+}
+
+// Decodes a frozen set into pts, reading it back from the spill file if it
+// was spilled.
+void unpack(const FrozenSet &fs, PtsSet &pts) {
+  std::string buffer;
+  const char *p = fs.packed.data();
+  if (fs.spilled) {
+    buffer.resize(fs.bytes);
+    if (pread(spillFd, &buffer[0], fs.bytes, fs.offset) != fs.bytes) {
+      errs() << "Cannot read spill file " << spillPath << "\n";
+      exit(1);
+    }
+    memStats.spillReads++;
+    memStats.bytesRead += fs.bytes;
+    p = buffer.data();
+  }
+  uint64_t count = getVarint(p), id = 0;
+  pts.set.reserve(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    id += getVarint(p);
+    pts.set.insert(objects[id]);
+  }
+}
+
+void thaw(Value *n, PtsSet &pts) {
+  auto begin = std::chrono::steady_clock::now();
+  auto it = frozen.find(n);
+  unpack(it->second, pts);
+  if (it->second.spilled)
+    spillLive -= it->second.bytes;
+  else
+    frozenBytes -= it->second.packed.capacity();
+  hotBytes += pts.set.getMemorySize();
+  frozen.erase(it);
+  memStats.thaws++;
+  memStats.time += std::chrono::steady_clock::now() - begin;
+}
+
+// All accesses to pt go through here, so that frozen sets are thawed first.
+PtsSet &ptOf(Value *n) {
+  PtsSet &pts = pt[n];
+  if (memBudget) {
+    lastUse[n] = useClock;
+    if (!frozen.empty() && frozen.count(n))
+      thaw(n, pts);
+  }
+  return pts;
+}
+
+// Moves the spilled sets to the front of the file, in file order, so each
+// one moves down into space that has already been read, and truncates it.
+bool compactSpill() {
+  std::vector<FrozenSet *> spilled;
+  for (auto &[n, fs] : frozen)
+    if (fs.spilled)
+      spilled.push_back(&fs);
+  std::sort(spilled.begin(), spilled.end(),
+            [](FrozenSet *a, FrozenSet *b) { return a->offset < b->offset; });
+  std::string buffer;
+  uint64_t end = 0;
+  for (FrozenSet *fs : spilled) {
+    if (fs->offset != end) {
+      buffer.resize(fs->bytes);
+      if (pread(spillFd, &buffer[0], fs->bytes, fs->offset) != fs->bytes ||
+          pwrite(spillFd, buffer.data(), fs->bytes, end) != fs->bytes)
+        return false;
+      fs->offset = end;
+    }
+    end += fs->bytes;
+  }
+  if (ftruncate(spillFd, end) != 0)
+    return false;
+  spillEnd = end;
+  memStats.compactions++;
+  return true;
+}
+
+// Brings the estimate down to 3/4 of the budget, so that shrinking does not
+// run again right away. Sets used within the last hotWindow pops are the
+// working set and stay as they are, even if that leaves the estimate over.
+const uint64_t hotWindow = 4096;
+
+void shrink() {
+  auto begin = std::chrono::steady_clock::now();
+  size_t target = memBudget / 4 * 3;
+  auto coldest = [](std::vector<std::pair<uint64_t, Value *>> &nodes) {
+    std::sort(nodes.begin(), nodes.end(),
+              [](auto &a, auto &b) { return a.first < b.first; });
+  };
+
+  std::vector<std::pair<uint64_t, Value *>> hot;
+  for (auto &[n, pts] : pt)
+    if (!pts.set.empty())
+      hot.push_back({lastUse.lookup(n), n});
+  coldest(hot);
+  for (auto [use, n] : hot) {
+    if (memUsage() <= target || use + hotWindow > useClock)
+      break;
+    freeze(n, pt[n]);
+  }
+
+  if (memUsage() > target && spillFd >= 0) {
+    // small files are not worth compacting
+    if (spillEnd - spillLive > std::max<uint64_t>(spillLive, 1 << 16) &&
+        !compactSpill()) {
+      errs() << "Cannot compact spill file " << spillPath << "\n";
+      exit(1);
+    }
+    std::vector<std::pair<uint64_t, Value *>> packed;
+    for (auto &[n, fs] : frozen)
+      if (!fs.spilled)
+        packed.push_back({lastUse.lookup(n), n});
+    coldest(packed);
+    for (auto [use, n] : packed) {
+      if (memUsage() <= target)
+        break;
+      if (!spill(frozen[n])) {
+        errs() << "Cannot write spill file " << spillPath << "\n";
+        break;
+      }
+    }
+  }
+  memStats.time += std::chrono::steady_clock::now() - begin;
+}
+
+// Recounts the estimate from scratch; the solver keeps it up to date from
+// then on.
+void countMemory() {
+  hotBytes = pfgBytes = pendingBytes = 0;
+  for (auto &[n, pts] : pt)
+    hotBytes += pts.set.getMemorySize();
+  for (auto &[s, targets] : PFG)
+    pfgBytes += targets.getMemorySize();
+  for (auto &[n, pts] : WLMap)
+    pendingBytes += pts.set.getMemorySize();
+}
+
+void worklistPush(Value *key, const PtsSet &sset) {
   auto it = WLMap.find(key);
   if (it != WLMap.end()) {
-    it->second.insert(sset.begin(), sset.end());
+    size_t before = it->second.set.getMemorySize();
+    it->second.insert(sset);
+    pendingBytes += it->second.set.getMemorySize() - before;
   } else {
-    WLMap[key] = sset;
+    PtsSet &pending = WLMap[key];
+    pending = sset;
+    pendingBytes += pending.set.getMemorySize();
   }
 }
 
 void addEdge(Value *s, Value *t) {
-  if (PFG[s].find(t) == PFG[s].end()) {
-    PFG[s].insert(t);
-    if (!pt[s].empty()) {
-      worklistPush(t, pt[s]);
+  auto &targets = PFG[s];
+  if (targets.find(t) == targets.end()) {
+    size_t before = targets.getMemorySize();
+    targets.insert(t);
+    pfgBytes += targets.getMemorySize() - before;
+    if (traceOut)
+      trace(solving ? TRACE_EDGE : TRACE_COPY, traceId(s), traceId(t));
+    PtsSet &pts = ptOf(s);
+    if (!pts.empty()) {
+      worklistPush(t, pts);
     }
   }
 }
 
-void propagate(Value *n, const DenseSet<Value *> &pts) {
+void propagate(Value *n, const PtsSet &pts) {
   if (!pts.empty()) {
-    pt[n].insert(pts.begin(), pts.end());
+    PtsSet &target = ptOf(n);
+    size_t before = target.set.getMemorySize();
+    target.insert(pts);
+    hotBytes += target.set.getMemorySize() - before;
+    if (traceOut)
+      trace(TRACE_PROPAGATE, traceId(n), PFG[n].size(), traceSize(pts));
     for (auto *s : PFG[n]) {
       worklistPush(s, pts);
     }
@@ -62,9 +491,13 @@ void initialize(Function &func) {
 
       if (auto *alloca = dyn_cast<AllocaInst>(&inst)) {
         worklistPush(alloca, {alloca});
+        if (traceOut)
+          trace(TRACE_ADDR, traceId(alloca), traceId(alloca));
 
       } else if (auto *gep = dyn_cast<GetElementPtrInst>(&inst)) {
         worklistPush(gep, {gep});
+        if (traceOut)
+          trace(TRACE_ADDR, traceId(gep), traceId(gep));
 
       } else if (auto *phi = dyn_cast<PHINode>(&inst)) {
         for (int i = 0; i < phi->getNumIncomingValues(); ++i) {
@@ -129,22 +562,211 @@ void addReachable(Function *func) {
   initialize(*func);
 }
 
+// Checkpointing.
+// Sorted, delta-encoded ID list.
+template <typename Range> void putIds(std::string &out, const Range &values) {
+  std::vector<uint64_t> ids;
+  for (Value *v : values)
+    ids.push_back(stableId.lookup(v));
+  std::sort(ids.begin(), ids.end());
+  putVarint(out, ids.size());
+  uint64_t prev = 0;
+  for (uint64_t id : ids) {
+    putVarint(out, id - prev);
+    prev = id;
+  }
+}
+
+void putPts(std::string &out, const PtsSet &pts) {
+  std::vector<Value *> values;
+  pts.forEach([&](Value *v) { values.push_back(v); });
+  putIds(out, values);
+}
+
+const char SNAPSHOT_MAGIC[] = "P2CK1";
+
+std::string encodeSnapshot() {
+  std::string out(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  putVarint(out, moduleFingerprint);
+  putIds(out, RM);
+  putVarint(out, pt.size());
+  for (auto &[n, pts] : pt) {
+    putVarint(out, stableId.lookup(n));
+    auto it = frozen.find(n);
+    if (it == frozen.end()) {
+      putPts(out, pts);
+    } else {
+      PtsSet unpacked;
+      unpack(it->second, unpacked);
+      putPts(out, unpacked);
+    }
+  }
+  putVarint(out, PFG.size());
+  for (auto &[s, targets] : PFG) {
+    putVarint(out, stableId.lookup(s));
+    putIds(out, targets);
+  }
+  putVarint(out, WLMap.size());
+  for (auto &[n, pts] : WLMap) {
+    putVarint(out, stableId.lookup(n));
+    putPts(out, pts);
+  }
+  return out;
+}
+
+struct SnapshotReader {
+  const std::string &data;
+  size_t pos = 0;
+  bool ok = true;
+
+  uint64_t varint() {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= data.size())
+        break;
+      unsigned char c = data[pos++];
+      x |= (uint64_t)(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return x;
+    }
+    ok = false;
+    return 0;
+  }
+
+  Value *value() {
+    uint64_t id = varint();
+    if (id >= byStableId.size()) {
+      ok = false;
+      return nullptr;
+    }
+    return byStableId[id];
+  }
+
+  template <typename Fn> void ids(Fn fn) {
+    uint64_t count = varint(), id = 0;
+    for (uint64_t i = 0; i < count && ok; ++i) {
+      id += varint();
+      if (id >= byStableId.size()) {
+        ok = false;
+        return;
+      }
+      fn(byStableId[id]);
+    }
+  }
+
+  PtsSet pts() {
+    PtsSet result;
+    ids([&](Value *v) { result.insert(PtsSet(v)); });
+    return result;
+  }
+};
+
+bool loadSnapshot(const char *filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+    return false;
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  if (data.compare(0, sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC,
+                   sizeof(SNAPSHOT_MAGIC)) != 0)
+    return false;
+  SnapshotReader reader{data, sizeof(SNAPSHOT_MAGIC)};
+  if (reader.varint() != moduleFingerprint)
+    return false;
+
+  reader.ids([](Value *v) { RM.insert(v); });
+  for (uint64_t i = reader.varint(); i > 0 && reader.ok; --i) {
+    Value *n = reader.value();
+    pt[n] = reader.pts();
+  }
+  for (uint64_t i = reader.varint(); i > 0 && reader.ok; --i) {
+    Value *s = reader.value();
+    auto &targets = PFG[s];
+    reader.ids([&](Value *t) { targets.insert(t); });
+  }
+  for (uint64_t i = reader.varint(); i > 0 && reader.ok; --i) {
+    Value *n = reader.value();
+    WLMap[n] = reader.pts();
+  }
+  return reader.ok && reader.pos == data.size();
+}
+
+// The snapshot is encoded on the solver thread, between two worklist pops,
+// and written out on a background thread. A snapshot that comes due while
+// the previous one is still being written is skipped. A failed write leaves
+// the previous checkpoint in place; its errno is reported by the solver
+// thread.
+const char *checkpointFile = nullptr;
+std::chrono::seconds checkpointInterval(600);
+std::thread checkpointWriter;
+std::atomic<bool> checkpointBusy{false};
+std::atomic<int> checkpointError{0};
+
+void writeSnapshot(std::string data) {
+  std::string tmp = std::string(checkpointFile) + ".tmp";
+  errno = 0;
+  bool written;
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(data.data(), data.size());
+    out.close();
+    written = !out.fail();
+  }
+  if (!written || std::rename(tmp.c_str(), checkpointFile) != 0) {
+    checkpointError = errno ? errno : EIO;
+    std::remove(tmp.c_str());
+  }
+  checkpointBusy = false;
+}
+
+// Reports a failure of the last background write, if any.
+void checkSnapshot() {
+  if (int error = checkpointError.exchange(0))
+    errs() << "Cannot write checkpoint " << checkpointFile << ": "
+           << std::strerror(error) << "\n";
+}
+
+void saveSnapshot() {
+  if (checkpointBusy)
+    return;
+  if (checkpointWriter.joinable())
+    checkpointWriter.join();
+  checkSnapshot();
+  checkpointBusy = true;
+  checkpointWriter = std::thread(writeSnapshot, encodeSnapshot());
+}
+
 void solve() {
+  solving = true;
+  auto nextCheckpoint = std::chrono::steady_clock::now() + checkpointInterval;
+  size_t pops = 0;
+  if (memBudget)
+    countMemory();
   while (!WLMap.empty()) {
     // errs() << "worklist size=" << worklist.size() << "\n";
+    useClock = ++pops;
+    if (bdd && bdd->numNodes() > bddGCThreshold)
+      collectGarbage();
+    if (memBudget && pops % hotWindow == 0) {
+      size_t usage = memUsage();
+      memStats.peak = std::max(memStats.peak, usage);
+      if (usage > memBudget)
+        shrink();
+    }
+    if (checkpointFile && (pops & 4095) == 0 &&
+        std::chrono::steady_clock::now() >= nextCheckpoint) {
+      saveSnapshot();
+      nextCheckpoint = std::chrono::steady_clock::now() + checkpointInterval;
+    }
     auto it = WLMap.begin();
     auto n = it->first;
+    pendingBytes -= it->second.set.getMemorySize();
     auto pts = it->second;
     WLMap.erase(it);
 
-    DenseSet<Value *> delta;
-    // DenseSet_difference(pts.begin(), pts.end(), pt[n].begin(), pt[n].end(),
-    //                     std::inserter(delta, delta.begin()));
-    for (auto &i : pts) {
-      if (!pt[n].contains(i)) {
-        delta.insert(i);
-      }
-    }
+    PtsSet delta = pts.minus(ptOf(n));
+    if (traceOut)
+      trace(TRACE_POP, traceId(n), traceSize(delta), traceSize(pts));
 
     propagate(n, delta);
 
@@ -154,9 +776,9 @@ void solve() {
         if (store->getPointerOperand() == n) {
           Value *y = store->getValueOperand();
           if (isa<Instruction>(y) || isa<Argument>(y)) {
-            for (Value *oi : delta) {
-              addEdge(y, oi);
-            }
+            if (traceOut && tracedUsers.insert(store).second)
+              trace(TRACE_STORE, traceId(n), traceId(y));
+            delta.forEach([&](Value *oi) { addEdge(y, oi); });
           }
         }
 
@@ -164,9 +786,9 @@ void solve() {
         // y = *x (load ptr x -> y)
         if (load->getPointerOperand() == n) {
           Value *y = load;
-          for (Value *oi : delta) {
-            addEdge(oi, y);
-          }
+          if (traceOut && tracedUsers.insert(load).second)
+            trace(TRACE_LOAD, traceId(y), traceId(n));
+          delta.forEach([&](Value *oi) { addEdge(oi, y); });
         }
       }
     }
@@ -182,9 +804,7 @@ void print() {
     if (points2.empty()) {
       outs() << "\tno points-to target\n";
     } else {
-      for (Value *v : points2) {
-        outs() << "\t" << *v << "\n";
-      }
+      points2.forEach([](Value *v) { outs() << "\t" << *v << "\n"; });
     }
   }
 
@@ -201,13 +821,47 @@ void print() {
 
 int main(int argc, char *argv[]) {
   InitLLVM X(argc, argv);
-  if (argc < 2) {
+  char *filename = nullptr;
+  char *resumeFile = nullptr;
+  char *traceFile = nullptr;
+  char *spillDir = nullptr;
+  bool useBDD = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--bdd") {
+      useBDD = true;
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      checkpointFile = argv[++i];
+    } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+      checkpointInterval = std::chrono::seconds(std::atol(argv[++i]));
+    } else if (arg == "--resume" && i + 1 < argc) {
+      resumeFile = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      traceFile = argv[++i];
+    } else if (arg == "--mem-budget" && i + 1 < argc) {
+      memBudget = (size_t)std::atoll(argv[++i]) << 20;
+    } else if (arg == "--spill-dir" && i + 1 < argc) {
+      spillDir = argv[++i];
+    } else {
+      filename = argv[i];
+    }
+  }
+  if (!filename) {
     outs() << "Expect IR filename\n";
     exit(1);
   }
+  if (memBudget && useBDD) {
+    // BDD nodes are shared between sets, so there is nothing to freeze
+    outs() << "--mem-budget needs hash set points-to sets\n";
+    exit(1);
+  }
+  if (traceFile && resumeFile) {
+    // the constraints from before the snapshot would be missing
+    outs() << "Cannot trace a resumed run\n";
+    exit(1);
+  }
   LLVMContext context;
   SMDiagnostic smd;
-  char *filename = argv[1];
   std::unique_ptr<Module> module = parseIRFile(filename, smd, context);
   if (!module) {
     outs() << "Cannot parse IR file\n";
@@ -223,14 +877,73 @@ int main(int argc, char *argv[]) {
 
   outs() << "Inter-Procedural Analysis" << "\n";
   outs() << module->getFunctionList().size() << " function(s)\n";
+  if (useBDD) {
+    // objects are instructions, so the instruction count bounds their IDs
+    size_t instNum = 0;
+    for (auto &func : *module)
+      for (auto &BB : func)
+        instNum += BB.size();
+    bdd = std::make_unique<BDD>(
+        std::max(1.0, std::ceil(std::log2(instNum + 1))));
+    outs() << "BDD points-to sets, " << bdd->numVars() << " variable(s)\n";
+  }
+  if (checkpointFile || resumeFile || traceFile)
+    numberValues(*module);
+  if (traceFile) {
+    // trace events hold 32-bit node IDs
+    if (byStableId.size() > UINT32_MAX) {
+      outs() << "Cannot trace a module with more than 2^32 values\n";
+      exit(1);
+    }
+    traceOut = fopen(traceFile, "wb");
+    if (!traceOut) {
+      outs() << "Cannot open trace file " << traceFile << "\n";
+      exit(1);
+    }
+    fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), traceOut);
+    traceBuffer.resize(1 << 16);
+  }
+  if (memBudget) {
+    std::error_code ec =
+        spillDir ? sys::fs::createUniqueFile(
+                       Twine(spillDir) + "/p2-spill-%%%%%%.bin", spillFd,
+                       spillPath)
+                 : sys::fs::createTemporaryFile("p2-spill", "bin", spillFd,
+                                                spillPath);
+    if (ec) {
+      outs() << "Cannot create spill file: " << ec.message() << "\n";
+      exit(1);
+    }
+    outs() << "Memory budget: " << (memBudget >> 20) << " MB, spill file "
+           << spillPath << "\n";
+  }
   auto start = std::chrono::high_resolution_clock::now();
 
-  addReachable(mainFunc);
+  if (resumeFile) {
+    if (!loadSnapshot(resumeFile)) {
+      outs() << "Cannot resume from " << resumeFile
+             << ": not a snapshot of this module\n";
+      exit(1);
+    }
+    outs() << "Resumed from " << resumeFile << ": " << RM.size()
+           << " reachable function(s), " << WLMap.size()
+           << " pending node(s)\n";
+  } else {
+    addReachable(mainFunc);
+  }
   auto checkpoint = std::chrono::high_resolution_clock::now();
 
   // outs() << "Solving...\n";
   solve();
   auto end = std::chrono::high_resolution_clock::now();
+  if (checkpointWriter.joinable())
+    checkpointWriter.join();
+  if (checkpointFile)
+    checkSnapshot();
+  if (traceOut) {
+    traceFlush();
+    fclose(traceOut);
+  }
 
   auto duration =
       std::chrono::duration_cast<std::chrono::microseconds>(end - start);
@@ -239,7 +952,48 @@ int main(int argc, char *argv[]) {
       std::chrono::duration_cast<std::chrono::microseconds>(end - checkpoint);
   outs() << "Solve time: " << duration.count() << " us\n";
 
+  size_t setBytes = 0;
+  if (bdd) {
+    collectGarbage();
+    setBytes = bdd->memorySize() + pt.size() * sizeof(PtsSet);
+    outs() << "BDD nodes: " << bdd->numNodes() << "\n";
+  } else {
+    for (auto &[n, pts] : pt)
+      setBytes += sizeof(PtsSet) + pts.set.getMemorySize();
+    setBytes += frozenBytes;
+  }
+  outs() << "Points-to set memory: " << setBytes << " bytes\n";
+
+  if (memBudget) {
+    memStats.peak = std::max(memStats.peak, memUsage());
+    auto memTime =
+        std::chrono::duration_cast<std::chrono::microseconds>(memStats.time)
+            .count();
+    outs() << "Peak memory estimate: " << (memStats.peak >> 20) << " MB\n";
+    outs() << "Frozen sets: " << memStats.freezes << " frozen, "
+           << memStats.thaws << " thawed, " << frozen.size()
+           << " still frozen\n";
+    outs() << "Spill I/O: " << memStats.spills << " write(s), "
+           << memStats.bytesWritten << " bytes; " << memStats.spillReads
+           << " read(s), " << memStats.bytesRead << " bytes\n";
+    if (spillFd >= 0)
+      outs() << "Spill file: " << spillEnd << " bytes at the end, "
+             << memStats.spillPeak << " at most, " << memStats.compactions
+             << " compaction(s)\n";
+    outs() << "Freeze/thaw/spill time: " << memTime << " us ("
+           << format("%.1f%%", duration.count() ? 100.0 * memTime /
+                                                      duration.count()
+                                                : 0.0)
+           << " of solve time)\n";
+  }
+
 #ifdef PRINT_RESULTS
+  for (auto &[n, pts] : pt)
+    ptOf(n);
   print();
 #endif
+  if (spillFd >= 0) {
+    close(spillFd);
+    sys::fs::remove(spillPath);
+  }
 }
\ No newline at end of file
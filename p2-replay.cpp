@@ -0,0 +1,344 @@
+// Replays a trace written by p2-inter-dense --trace. It summarizes the
+// recorded solver dynamics, then solves the recorded constraints again with
+// each points-to set backend, so containers can be compared without parsing
+// the IR. --mix FILE also writes the set operations of the DenseSet run as a
+// p2-bench operation mix.
+
+#include "trace.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+struct Constraints {
+  uint32_t numNodes = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> addrs;
+  std::vector<std::pair<uint32_t, uint32_t>> copies;
+  std::vector<std::vector<uint32_t>> loadsFrom; // x -> {y | y = *x}
+  std::vector<std::vector<uint32_t>> storesTo;  // x -> {y | *x = y}
+};
+
+struct Dynamics {
+  size_t pops = 0, emptyDeltas = 0, edges = 0, propagates = 0;
+  size_t unsized = 0; // pops without set sizes (--bdd)
+  uint64_t deltaTotal = 0, ptsTotal = 0, pushes = 0;
+  uint32_t deltaMax = 0;
+};
+
+bool readTrace(const char *filename, std::vector<TraceEvent> &events) {
+  FILE *in = fopen(filename, "rb");
+  if (!in)
+    return false;
+  char magic[sizeof(TRACE_MAGIC)];
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+    fclose(in);
+    return false;
+  }
+  TraceEvent buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, sizeof(TraceEvent), 4096, in)) > 0)
+    events.insert(events.end(), buffer, buffer + n);
+  fclose(in);
+  return true;
+}
+
+void collect(const std::vector<TraceEvent> &events, Constraints &cs,
+             Dynamics &dyn) {
+  // b of POP and PROPAGATE is a count, not a node
+  for (auto &e : events) {
+    if (e.kind != TRACE_POP && e.kind != TRACE_PROPAGATE)
+      cs.numNodes = std::max({cs.numNodes, e.a + 1, e.b + 1});
+  }
+  cs.loadsFrom.resize(cs.numNodes);
+  cs.storesTo.resize(cs.numNodes);
+  for (auto &e : events) {
+    switch (e.kind) {
+    case TRACE_ADDR:
+      cs.addrs.push_back({e.a, e.b});
+      break;
+    case TRACE_COPY:
+      cs.copies.push_back({e.a, e.b});
+      break;
+    case TRACE_LOAD:
+      cs.loadsFrom[e.b].push_back(e.a);
+      break;
+    case TRACE_STORE:
+      cs.storesTo[e.a].push_back(e.b);
+      break;
+    case TRACE_POP:
+      dyn.pops++;
+      dyn.emptyDeltas += e.b == 0;
+      if (e.n == TRACE_NO_SIZE) {
+        dyn.unsized++;
+        break;
+      }
+      dyn.ptsTotal += e.n;
+      dyn.deltaTotal += e.b;
+      dyn.deltaMax = std::max(dyn.deltaMax, e.b);
+      break;
+    case TRACE_EDGE:
+      dyn.edges++;
+      break;
+    case TRACE_PROPAGATE:
+      dyn.propagates++;
+      dyn.pushes += e.b;
+      break;
+    }
+  }
+}
+
+// Set backends, keyed by node ID.
+struct DenseBackend {
+  static constexpr const char *name = "DenseSet";
+  DenseSet<uint32_t> s;
+  bool empty() const { return s.empty(); }
+  size_t size() const { return s.size(); }
+  void insert(uint32_t x) { s.insert(x); }
+  void unite(const DenseBackend &o) { s.insert(o.s.begin(), o.s.end()); }
+  DenseBackend minus(const DenseBackend &o) const {
+    DenseBackend r;
+    for (uint32_t x : s)
+      if (!o.s.contains(x))
+        r.s.insert(x);
+    return r;
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (uint32_t x : s)
+      fn(x);
+  }
+};
+
+struct StdSetBackend {
+  static constexpr const char *name = "std::set";
+  std::set<uint32_t> s;
+  bool empty() const { return s.empty(); }
+  size_t size() const { return s.size(); }
+  void insert(uint32_t x) { s.insert(x); }
+  void unite(const StdSetBackend &o) { s.insert(o.s.begin(), o.s.end()); }
+  StdSetBackend minus(const StdSetBackend &o) const {
+    StdSetBackend r;
+    std::set_difference(s.begin(), s.end(), o.s.begin(), o.s.end(),
+                        std::inserter(r.s, r.s.begin()));
+    return r;
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (uint32_t x : s)
+      fn(x);
+  }
+};
+
+struct SparseBitVectorBackend {
+  static constexpr const char *name = "SparseBitVector";
+  SparseBitVector<128> s;
+  bool empty() const { return s.empty(); }
+  size_t size() const { return s.count(); }
+  void insert(uint32_t x) { s.set(x); }
+  void unite(const SparseBitVectorBackend &o) { s |= o.s; }
+  SparseBitVectorBackend minus(const SparseBitVectorBackend &o) const {
+    SparseBitVectorBackend r;
+    r.s.intersectWithComplement(s, o.s);
+    return r;
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (unsigned x : s)
+      fn(x);
+  }
+};
+
+struct SortedVectorBackend {
+  static constexpr const char *name = "sorted vector";
+  std::vector<uint32_t> s;
+  bool empty() const { return s.empty(); }
+  size_t size() const { return s.size(); }
+  void insert(uint32_t x) {
+    auto it = std::lower_bound(s.begin(), s.end(), x);
+    if (it == s.end() || *it != x)
+      s.insert(it, x);
+  }
+  void unite(const SortedVectorBackend &o) {
+    std::vector<uint32_t> merged;
+    merged.reserve(s.size() + o.s.size());
+    std::set_union(s.begin(), s.end(), o.s.begin(), o.s.end(),
+                   std::back_inserter(merged));
+    s.swap(merged);
+  }
+  SortedVectorBackend minus(const SortedVectorBackend &o) const {
+    SortedVectorBackend r;
+    std::set_difference(s.begin(), s.end(), o.s.begin(), o.s.end(),
+                        std::back_inserter(r.s));
+    return r;
+  }
+  template <typename Fn> void forEach(Fn fn) const {
+    for (uint32_t x : s)
+      fn(x);
+  }
+};
+
+// The worklist algorithm of p2-inter-dense over a recorded constraint set.
+template <class Set> struct Replay {
+  const Constraints &cs;
+  std::vector<Set> pt;
+  std::vector<DenseSet<uint32_t>> PFG;
+  DenseMap<uint32_t, Set> WLMap;
+  size_t pops = 0;
+  std::ofstream *mix = nullptr;
+
+  explicit Replay(const Constraints &cs)
+      : cs(cs), pt(cs.numNodes), PFG(cs.numNodes) {}
+
+  void worklistPush(uint32_t key, const Set &sset) {
+    auto it = WLMap.find(key);
+    if (it != WLMap.end())
+      it->second.unite(sset);
+    else
+      WLMap[key] = sset;
+  }
+
+  void addEdge(uint32_t s, uint32_t t) {
+    if (PFG[s].insert(t).second && !pt[s].empty())
+      worklistPush(t, pt[s]);
+  }
+
+  // In the mix, set n is pt[n] and the two sets after the last node hold
+  // the popped set and its delta.
+  void logPop(uint32_t n, const Set &pts, const Set &delta) {
+    uint32_t in = cs.numNodes, d = cs.numNodes + 1;
+    *mix << "x " << in << "\n";
+    pts.forEach([&](uint32_t x) { *mix << "i " << in << " " << x << "\n"; });
+    *mix << "d " << d << " " << in << " " << n << "\n";
+    if (!delta.empty())
+      *mix << "u " << n << " " << d << "\n";
+    *mix << "t " << d << "\n";
+  }
+
+  void solve() {
+    for (auto [a, b] : cs.addrs) {
+      Set single;
+      single.insert(b);
+      worklistPush(a, single);
+    }
+    for (auto [s, t] : cs.copies)
+      addEdge(s, t);
+
+    while (!WLMap.empty()) {
+      auto it = WLMap.begin();
+      uint32_t n = it->first;
+      Set pts = std::move(it->second);
+      WLMap.erase(it);
+      pops++;
+
+      Set delta = pts.minus(pt[n]);
+      if (mix)
+        logPop(n, pts, delta);
+      if (delta.empty())
+        continue;
+      pt[n].unite(delta);
+      for (uint32_t s : PFG[n])
+        worklistPush(s, delta);
+      for (uint32_t y : cs.storesTo[n])
+        delta.forEach([&](uint32_t o) { addEdge(y, o); });
+      for (uint32_t y : cs.loadsFrom[n])
+        delta.forEach([&](uint32_t o) { addEdge(o, y); });
+    }
+  }
+
+  uint64_t total() const {
+    uint64_t sum = 0;
+    for (auto &s : pt)
+      sum += s.size();
+    return sum;
+  }
+};
+
+template <class Set>
+void run(const Constraints &cs, std::ofstream *mix = nullptr) {
+  Replay<Set> replay(cs);
+  replay.mix = mix;
+  auto start = std::chrono::steady_clock::now();
+  replay.solve();
+  auto end = std::chrono::steady_clock::now();
+  outs() << format(
+      "%-18s %12lld %12zu %14llu\n", Set::name,
+      (long long)std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                       start)
+          .count(),
+      replay.pops, (unsigned long long)replay.total());
+}
+
+int main(int argc, char *argv[]) {
+  const char *traceFile = nullptr;
+  const char *mixFile = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--mix" && i + 1 < argc)
+      mixFile = argv[++i];
+    else
+      traceFile = argv[i];
+  }
+  if (!traceFile) {
+    errs() << "Expect trace filename\n";
+    exit(1);
+  }
+  std::vector<TraceEvent> events;
+  if (!readTrace(traceFile, events)) {
+    errs() << "Cannot read trace file " << traceFile << "\n";
+    exit(1);
+  }
+
+  Constraints cs;
+  Dynamics dyn;
+  collect(events, cs, dyn);
+  size_t loads = 0, stores = 0;
+  for (uint32_t n = 0; n < cs.numNodes; ++n) {
+    loads += cs.loadsFrom[n].size();
+    stores += cs.storesTo[n].size();
+  }
+
+  outs() << events.size() << " event(s), " << cs.numNodes << " node(s)\n";
+  outs() << "Constraints: " << cs.addrs.size() << " addr, "
+         << cs.copies.size() << " copy, " << loads << " load, " << stores
+         << " store\n";
+  outs() << "Recorded pops: " << dyn.pops << " (" << dyn.emptyDeltas
+         << " with empty delta)\n";
+  if (size_t sized = dyn.pops - dyn.unsized)
+    outs() << format("Mean popped set: %.1f, mean delta: %.1f, max delta: %u\n",
+                     (double)dyn.ptsTotal / sized,
+                     (double)dyn.deltaTotal / sized, dyn.deltaMax);
+  if (dyn.unsized)
+    outs() << "Set sizes not recorded for " << dyn.unsized
+           << " pop(s) (--bdd trace)\n";
+  if (dyn.pops)
+    outs() << format("Edges created per pop: %.2f\n",
+                     (double)dyn.edges / dyn.pops);
+  if (dyn.propagates)
+    outs() << format("Successors per propagate: %.2f\n",
+                     (double)dyn.pushes / dyn.propagates);
+
+  outs() << "\n"
+         << left_justify("backend", 18) << right_justify("time(us)", 13)
+         << right_justify("pops", 13) << right_justify("sum |pt|", 15)
+         << "\n";
+  if (mixFile) {
+    std::ofstream mix(mixFile);
+    mix << "# recorded from " << traceFile << "\n";
+    run<DenseBackend>(cs, &mix);
+  } else {
+    run<DenseBackend>(cs);
+  }
+  run<StdSetBackend>(cs);
+  run<SparseBitVectorBackend>(cs);
+  run<SortedVectorBackend>(cs);
+}
@@ -1,3 +1,5 @@
+#include "unify.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
@@ -9,143 +11,122 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <set>
 #include <unordered_map>
 #include <vector>
 #include <chrono>
 
 using namespace llvm;
 
-std::unordered_map<Value *, Value *> ds_parent;
-std::unordered_map<Value *, int> ds_rank;
-std::unordered_map<Value *, Value *> points2;
+// Every value of interest gets a union-find node the first time it is seen.
+DenseMap<Value *, unsigned> ids;
+std::vector<Value *> values; // nullptr for synthetic nodes
+UnionFind uf;
+DenseMap<Function *, unsigned> retNode;
 
-Value *findDS(Value *x) {
-  if (ds_parent.find(x) == ds_parent.end()) {
-    ds_parent[x] = x;
-    ds_rank[x] = 0;
-    return x;
-  }
-  if (x != ds_parent[x]) {
-    ds_parent[x] = findDS(ds_parent[x]);
-  }
-  return ds_parent[x];
+unsigned newNode(Value *v) {
+  values.push_back(v);
+  return uf.makeNode();
 }
 
-void unionDS(Value *p, Value *q) {
-  Value *x = findDS(p);
-  Value *y = findDS(q);
-  if (x == y)
-    return;
-  if (ds_rank[x] < ds_rank[y]) {
-    ds_parent[x] = y;
-  } else if (ds_rank[x] > ds_rank[y]) {
-    ds_parent[y] = x;
-  } else {
-    ds_parent[y] = x;
-    ds_rank[x]++;
-  }
+unsigned getId(Value *v) {
+  auto [it, inserted] = ids.try_emplace(v, 0);
+  if (inserted)
+    it->second = newNode(v);
+  return it->second;
+}
+
+// Values that name a pointer; other constants would merge unrelated classes.
+bool isNode(Value *v) {
+  return isa<Instruction>(v) || isa<Argument>(v) || isa<GlobalValue>(v);
+}
+
+unsigned getRetNode(Function *func) {
+  auto [it, inserted] = retNode.try_emplace(func, 0);
+  if (inserted)
+    it->second = newNode(nullptr);
+  return it->second;
 }
 
 void printGroups() {
-  std::unordered_map<Value *, std::vector<Value *>> groups;
-  std::unordered_map<Value *, std::set<Value *>> gp2;
-  for (auto [key, val] : ds_parent) {
-    Value *root = findDS(key);
-    groups[root].push_back(key);
-  }
-  for (auto &[key, group] : groups) {
-    for (auto val : group) {
-      if (points2.find(val) != points2.end()) {
-        gp2[key].insert(findDS(points2[val]));
-      }
-    }
+  std::unordered_map<unsigned, std::vector<Value *>> groups;
+  for (unsigned n = 0; n < uf.size(); ++n) {
+    if (values[n])
+      groups[uf.find(n)].push_back(values[n]);
   }
   for (auto &[key, group] : groups) {
     outs() << "\nGroup " << key << ": {";
     for (auto val : group) {
       outs() << "\n" << *val;
     }
-    outs() << "\n}\nPoints-to group(s): {";
-    for (auto val : gp2[key]) {
-      outs() << " " << val;
-    }
+    outs() << "\n}\nPoints-to group: {";
+    unsigned p = uf.pointee(key);
+    if (p != UnionFind::NONE)
+      outs() << " " << p;
     outs() << " }\n";
   }
 }
 
 void steensgaard(Instruction *inst) {
   if (auto *ac = dyn_cast<AllocaInst>(inst)) {
-    findDS(ac);
-    points2[ac] = ac;
+    // a fresh location: nothing stored in it yet
+    getId(ac);
 
   } else if (auto *ld = dyn_cast<LoadInst>(inst)) {
     // [p := *q] -> join(*p, **q)
-    auto *q = ld->getPointerOperand();
-    if (points2.find(q) == points2.end()) {
-      findDS(q);
-      findDS(ld);
-      points2[q] = ld;
-    } else {
-      unionDS(points2[q], ld);
-    }
+    uf.joinPointee(getId(ld->getPointerOperand()), getId(ld));
 
   } else if (auto *st = dyn_cast<StoreInst>(inst)) {
     // [*p := q] -> join(**p, *q)
-    auto *p = st->getPointerOperand();
     auto *q = st->getValueOperand();
-    if (isa<Instruction>(q) || isa<Argument>(q)) {
-      if (points2.find(p) == points2.end()) {
-        findDS(p);
-        findDS(q);
-        points2[p] = q;
-      } else {
-        unionDS(points2[p], q);
-      }
+    if (isNode(q)) {
+      uf.joinPointee(getId(st->getPointerOperand()), getId(q));
     }
 
   } else if (PHINode *phi = dyn_cast<PHINode>(inst)) {
     // join incoming ptrs with phi var
-    for (int i = 0; i < phi->getNumIncomingValues(); ++i) {
+    unsigned p = getId(phi);
+    for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
       auto *val = phi->getIncomingValue(i);
-      if (isa<Instruction>(val) || isa<Argument>(val)) {
-        unionDS(phi, val);
+      if (isNode(val)) {
+        uf.join(p, getId(val));
       }
     }
 
   } else if (auto *select = dyn_cast<SelectInst>(inst)) {
     Value *tval = select->getTrueValue();
     Value *fval = select->getFalseValue();
-    if (isa<Instruction>(tval) || isa<Argument>(tval)) {
-      unionDS(tval, select);
+    if (isNode(tval)) {
+      uf.join(getId(tval), getId(select));
     }
-    if (isa<Instruction>(fval) || isa<Argument>(fval)) {
-      unionDS(fval, select);
+    if (isNode(fval)) {
+      uf.join(getId(fval), getId(select));
     }
 
   } else if (auto *cast = dyn_cast<CastInst>(inst)) {
     Value *src = cast->getOperand(0);
-    unionDS(src, cast);
+    if (isNode(src)) {
+      uf.join(getId(src), getId(cast));
+    }
 
   } else if (auto *call = dyn_cast<CallInst>(inst)) {
     auto *cf = call->getCalledFunction();
     if (!cf || cf->isDeclaration())
       return;
-    for (int i = 0; i < call->arg_size(); ++i) {
-      if (i < cf->arg_size()) {
-        unionDS(call->getArgOperand(i), cf->getArg(i));
+    for (unsigned i = 0; i < call->arg_size() && i < cf->arg_size(); ++i) {
+      Value *arg = call->getArgOperand(i);
+      if (isNode(arg)) {
+        uf.join(getId(arg), getId(cf->getArg(i)));
       }
     }
+    // returns are joined into one node per callee as they are visited
     if (!cf->getReturnType()->isVoidTy()) {
-      for (auto &cfBB : *cf) {
-        for (auto &cfinst : cfBB) {
-          if (auto *ret = llvm::dyn_cast<llvm::ReturnInst>(&cfinst)) {
-            Value *retVal = ret->getReturnValue();
-            if (retVal)
-              unionDS(retVal, call);
-          }
-        }
-      }
+      uf.join(getRetNode(cf), getId(call));
+    }
+
+  } else if (auto *ret = dyn_cast<ReturnInst>(inst)) {
+    Value *retVal = ret->getReturnValue();
+    if (retVal && isNode(retVal)) {
+      uf.join(getId(retVal), getRetNode(ret->getFunction()));
     }
   }
 }
@@ -169,14 +150,19 @@ int main(int argc, char *argv[]) {
   outs() << "Steensgaard's Analysis\n";
   outs() << module->getFunctionList().size() << " function(s)\n";
   auto start = std::chrono::high_resolution_clock::now();
+  size_t instNum = 0;
+  for (auto &func : *module) {
+    for (auto &BB : func)
+      instNum += BB.size();
+  }
+  ids.reserve(instNum);
+  values.reserve(instNum);
+  uf.reserve(instNum);
+
   for (auto &func : *module) {
     if (func.isDeclaration())
       continue;
 
-    // ds_parent.clear();
-    // ds_rank.clear();
-    // points2.clear();
-
     for (auto &BB : func) {
       for (auto &inst : BB) {
         steensgaard(&inst);
@@ -190,6 +176,10 @@ int main(int argc, char *argv[]) {
   auto duration =
       std::chrono::duration_cast<std::chrono::microseconds>(end - start);
   outs() << "Analysis time: " << duration.count() << " us\n";
+  size_t classes = 0;
+  for (unsigned n = 0; n < uf.size(); ++n)
+    classes += uf.find(n) == n;
+  outs() << uf.size() << " node(s), " << classes << " class(es)\n";
 #ifdef PRINT_RESULTS
   printGroups();
 #endif
@@ -1,3 +1,4 @@
+#include "unify.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
@@ -6,37 +7,191 @@
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <cmath>
 #include <string>
 #include <fstream>
+#include <vector>
 
 using namespace llvm;
 
 
 std::mutex outsmtx;
 
+// Run configuration, set from the command line.
+struct Options {
+  bool concurrent = false;
+  int nthreads = std::max(1u, std::thread::hardware_concurrency());
+  bool sweep = false; // time the pool with 1, 2, 4, ... nthreads threads
+  bool stats = false;
+  bool timeline = false;
+  bool csv = false;
+  int runs = 1;
+  int warmup = 0;
+  bool printResults = false;
+  const char *modelFile = nullptr;
+  // Budgets are in microseconds / worklist pops; 0 means unlimited.
+  long long funcTimeBudget = 0;
+  size_t funcWorkBudget = 0;
+  long long totalTimeBudget = 0;
+  // Functions with at least this many BBs are solved by all threads together.
+  size_t parallelThreshold = 10000;
+  bool slice = false;
+  std::vector<std::pair<std::string, std::string>> queries; // function, value
+};
+
+Options opts;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Budget {
+  bool timed = false;
+  Clock::time_point deadline;
+  size_t max_pops = 0;
+};
+
+// Whole-program deadline, shared by every task.
+bool programTimed = false;
+Clock::time_point programDeadline;
+
+Budget makeBudget() {
+  Budget budget;
+  budget.max_pops = opts.funcWorkBudget;
+  if (opts.funcTimeBudget > 0) {
+    budget.timed = true;
+    budget.deadline =
+        Clock::now() + std::chrono::microseconds(opts.funcTimeBudget);
+  }
+  if (programTimed && (!budget.timed || programDeadline < budget.deadline)) {
+    budget.timed = true;
+    budget.deadline = programDeadline;
+  }
+  return budget;
+}
+
+// Static features of a function, in CSV column order.
+const std::vector<std::string> featureNames = {
+    "size", "inum", "loads", "stores", "phis",
+    "geps", "allocas", "casts", "selects"};
+
+std::vector<double> computeFeatures(Function &func) {
+  std::vector<double> f(featureNames.size(), 0);
+  f[0] = func.size();
+  for (auto &BB : func) {
+    f[1] += BB.size();
+    for (auto &inst : BB) {
+      f[2] += isa<LoadInst>(&inst);
+      f[3] += isa<StoreInst>(&inst);
+      f[4] += isa<PHINode>(&inst);
+      f[5] += isa<GetElementPtrInst>(&inst);
+      f[6] += isa<AllocaInst>(&inst);
+      f[7] += isa<CastInst>(&inst);
+      f[8] += isa<SelectInst>(&inst);
+    }
+  }
+  return f;
+}
+
+// Linear model of solve time in us, as written by p2-fit. Without a model
+// the cost of a function is its BB count.
+struct CostModel {
+  bool loaded = false;
+  double intercept = 0;
+  std::vector<double> coef = std::vector<double>(featureNames.size(), 0);
+
+  double predict(Function &func) const {
+    if (!loaded)
+      return func.size();
+    auto f = computeFeatures(func);
+    double cost = intercept;
+    for (size_t i = 0; i < f.size(); ++i)
+      cost += coef[i] * f[i];
+    return cost > 0 ? cost : 0;
+  }
+};
+
+bool loadCostModel(const char *filename, CostModel &model) {
+  std::ifstream in(filename);
+  if (!in)
+    return false;
+  std::string name;
+  double value;
+  while (in >> name >> value) {
+    if (name == "intercept") {
+      model.intercept = value;
+      continue;
+    }
+    auto it = std::find(featureNames.begin(), featureNames.end(), name);
+    if (it == featureNames.end())
+      return false;
+    model.coef[it - featureNames.begin()] = value;
+  }
+  model.loaded = true;
+  return true;
+}
+
 struct TaskInfo {
   Function *func;
   size_t size;
   int index;
+  double cost;
 
-  bool operator<(const TaskInfo &rhs) const { return size < rhs.size; }
+  bool operator<(const TaskInfo &rhs) const { return cost < rhs.cost; }
+};
+
+// Makespan of greedy list scheduling of tasks, in the given order, onto
+// nthreads threads.
+double simulateMakespan(const std::vector<double> &costs, int nthreads) {
+  std::priority_queue<double, std::vector<double>, std::greater<double>> loads;
+  for (int i = 0; i < nthreads; ++i)
+    loads.push(0);
+  double makespan = 0;
+  for (double c : costs) {
+    double load = loads.top() + c;
+    loads.pop();
+    loads.push(load);
+    makespan = std::max(makespan, load);
+  }
+  return makespan;
+}
+
+// Set operations done by initialize() and solve(), reported per function
+// in CSV mode.
+struct OpCounts {
+  size_t pushes = 0; // worklist pushes
+  size_t pops = 0;   // worklist pops, each diffing the popped set against pt
+  size_t unions = 0; // non-empty deltas merged into pt
+  size_t edges = 0;  // PFG edges added
 };
 
 struct LocalData {
   std::unordered_map<Value *, std::set<Value *>> pt;
   std::queue<std::pair<Value *, std::set<Value *>>> worklist;
   std::unordered_map<Value *, std::set<Value *>> PFG;
+  OpCounts ops;
+  bool sliced = false;
+  std::unordered_set<Value *> slice;
+  size_t sliceNodes = 0; // args + instructions of the function
+  double sliceTime = 0;  // us
+
+  bool inSlice(Value *v) const { return !sliced || slice.count(v); }
 };
 
 void addEdge(Value *s, Value *t, LocalData &localdata) {
@@ -45,8 +200,10 @@ void addEdge(Value *s, Value *t, LocalData &localdata) {
   auto& PFG = localdata.PFG;
   if (PFG[s].find(t) == PFG[s].end()) {
     PFG[s].insert(t);
+    localdata.ops.edges++;
     if (!pt[s].empty()) {
       worklist.push({t, pt[s]});
+      localdata.ops.pushes++;
     }
   }
 }
@@ -57,9 +214,11 @@ void propagate(Value *n, const std::set<Value *> &pts, LocalData &localdata) {
   auto &PFG = localdata.PFG;
   if (!pts.empty()) {
     pt[n].insert(pts.begin(), pts.end());
+    localdata.ops.unions++;
     for (auto *s : PFG[n]) {
       worklist.push({s, pts});
     }
+    localdata.ops.pushes += PFG[n].size();
   }
 }
 
@@ -67,17 +226,22 @@ void initialize(Function &func, LocalData& localdata) {
   auto &worklist = localdata.worklist;
   for (auto &BB : func) {
     for (auto &inst : BB) {
+      if (!localdata.inSlice(&inst))
+        continue;
 
       if (auto *alloca = dyn_cast<AllocaInst>(&inst)) {
         worklist.push({alloca, {alloca}});
+        localdata.ops.pushes++;
 
       } else if (auto *gep = dyn_cast<GetElementPtrInst>(&inst)) {
         worklist.push({gep, {gep}});
+        localdata.ops.pushes++;
 
       } else if (auto *phi = dyn_cast<PHINode>(&inst)) {
         for (int i = 0; i < phi->getNumIncomingValues(); ++i) {
           Value *val = phi->getIncomingValue(i);
-          if (isa<Instruction>(val) || isa<Argument>(val)) {
+          if ((isa<Instruction>(val) || isa<Argument>(val)) &&
+              localdata.inSlice(val)) {
             addEdge(val, phi, localdata);
           }
         }
@@ -85,33 +249,46 @@ void initialize(Function &func, LocalData& localdata) {
       } else if (auto *select = dyn_cast<SelectInst>(&inst)) {
         Value *tval = select->getTrueValue();
         Value *fval = select->getFalseValue();
-        if (isa<Instruction>(tval) || isa<Argument>(tval)) {
+        if ((isa<Instruction>(tval) || isa<Argument>(tval)) &&
+            localdata.inSlice(tval)) {
           addEdge(tval, select, localdata);
         }
-        if (isa<Instruction>(fval) || isa<Argument>(fval)) {
+        if ((isa<Instruction>(fval) || isa<Argument>(fval)) &&
+            localdata.inSlice(fval)) {
           addEdge(fval, select, localdata);
         }
 
       } else if (auto *cast = dyn_cast<CastInst>(&inst)) {
         Value *src = cast->getOperand(0);
-        addEdge(src, cast, localdata);
+        if (localdata.inSlice(src))
+          addEdge(src, cast, localdata);
       }
       // iter end
     }
   }
 }
 
-void solve(LocalData& localdata) {
+// Returns false if the budget ran out before reaching the fixpoint.
+bool solve(LocalData &localdata, const Budget &budget = Budget()) {
   auto &pt = localdata.pt;
   auto &worklist = localdata.worklist;
   // auto &PFG = localdata.PFG;
+  size_t pops = 0;
   while (!worklist.empty()) {
+    ++pops;
+    if (budget.max_pops && pops > budget.max_pops)
+      return false;
+    // reading the clock on every pop is too costly
+    if (budget.timed && (pops & 1023) == 0 && Clock::now() >= budget.deadline)
+      return false;
+
     auto [n, pts] = worklist.front();
     worklist.pop();
 
     std::set<Value *> delta;
     std::set_difference(pts.begin(), pts.end(), pt[n].begin(), pt[n].end(),
                         std::inserter(delta, delta.begin()));
+    localdata.ops.pops++;
     propagate(n, delta, localdata);
 
     for (auto *user : n->users()) {
@@ -119,7 +296,8 @@ void solve(LocalData& localdata) {
         // *x = y (store y -> ptr x)
         if (store->getPointerOperand() == n) {
           Value *y = store->getValueOperand();
-          if (isa<Instruction>(y) || isa<Argument>(y)) {
+          if ((isa<Instruction>(y) || isa<Argument>(y)) &&
+              localdata.inSlice(store)) {
             for (Value *oi : delta) {
               addEdge(y, oi, localdata);
             }
@@ -128,7 +306,7 @@ void solve(LocalData& localdata) {
 
       } else if (LoadInst *load = dyn_cast<LoadInst>(user)) {
         // y = *x (load ptr x -> y)
-        if (load->getPointerOperand() == n) {
+        if (load->getPointerOperand() == n && localdata.inSlice(load)) {
           Value *y = load;
           for (Value *oi : delta) {
             addEdge(oi, y, localdata);
@@ -138,6 +316,493 @@ void solve(LocalData& localdata) {
     }
     // iter end
   }
+  return true;
+}
+
+// Intra-function parallel solving. Nodes are partitioned among shards by
+// hash; a shard owns pt and PFG of its nodes and is the only one to touch
+// them. Points-to updates and new edges are sent as messages to the owner of
+// the node they modify.
+struct Message {
+  Value *node;
+  Value *target; // non-null: add edge node -> target
+  std::set<Value *> pts;
+};
+
+struct Shard {
+  LocalData data;
+  std::mutex mtx;
+  std::vector<Message> inbox;
+};
+
+struct ParallelData {
+  std::vector<Shard> shards;
+  std::atomic<size_t> pending{0};
+  std::atomic<size_t> pops{0};
+  std::atomic<bool> stop{false};
+  Budget budget;
+  const std::unordered_set<Value *> *slice = nullptr;
+
+  explicit ParallelData(int n) : shards(n) {}
+
+  unsigned owner(Value *v) const {
+    auto h = reinterpret_cast<uintptr_t>(v) >> 4;
+    return (h * 0x9E3779B97F4A7C15ull >> 32) % shards.size();
+  }
+};
+
+void shardSolve(ParallelData &pd, unsigned tid) {
+  const size_t FLUSH_EVERY = 256;
+  auto &self = pd.shards[tid];
+  auto &pt = self.data.pt;
+  auto &PFG = self.data.PFG;
+  std::queue<Message> work;
+  std::vector<std::vector<Message>> outbox(pd.shards.size());
+  size_t processed = 0;
+  size_t pops = 0; // points-to messages, the pops of solve()
+
+  auto send = [&](Message msg) {
+    pd.pending++;
+    unsigned o = pd.owner(msg.node);
+    if (o == tid)
+      work.push(std::move(msg));
+    else
+      outbox[o].push_back(std::move(msg));
+  };
+  auto flush = [&]() {
+    for (unsigned o = 0; o < outbox.size(); ++o) {
+      if (outbox[o].empty())
+        continue;
+      std::lock_guard<std::mutex> lock(pd.shards[o].mtx);
+      auto &inbox = pd.shards[o].inbox;
+      std::move(outbox[o].begin(), outbox[o].end(), std::back_inserter(inbox));
+      outbox[o].clear();
+    }
+    // only retire messages once everything they produced is visible
+    pd.pending -= processed;
+    pd.pops += pops;
+    processed = pops = 0;
+    if ((pd.budget.max_pops && pd.pops > pd.budget.max_pops) ||
+        (pd.budget.timed && Clock::now() >= pd.budget.deadline))
+      pd.stop = true;
+  };
+
+  while (!pd.stop) {
+    {
+      std::lock_guard<std::mutex> lock(self.mtx);
+      for (auto &msg : self.inbox)
+        work.push(std::move(msg));
+      self.inbox.clear();
+    }
+    if (work.empty()) {
+      if (pd.pending == 0)
+        break;
+      std::this_thread::yield();
+      continue;
+    }
+
+    while (!work.empty() && !pd.stop) {
+      Message msg = std::move(work.front());
+      work.pop();
+      Value *n = msg.node;
+
+      if (msg.target) {
+        // addEdge(n, target)
+        if (PFG[n].insert(msg.target).second && !pt[n].empty()) {
+          send({msg.target, nullptr, pt[n]});
+        }
+
+      } else {
+        pops++;
+        std::set<Value *> delta;
+        std::set_difference(msg.pts.begin(), msg.pts.end(), pt[n].begin(),
+                            pt[n].end(), std::inserter(delta, delta.begin()));
+        if (!delta.empty()) {
+          pt[n].insert(delta.begin(), delta.end());
+          for (auto *s : PFG[n]) {
+            send({s, nullptr, delta});
+          }
+        }
+
+        for (auto *user : n->users()) {
+          if (StoreInst *store = dyn_cast<StoreInst>(user)) {
+            if (store->getPointerOperand() == n) {
+              Value *y = store->getValueOperand();
+              if ((isa<Instruction>(y) || isa<Argument>(y)) &&
+                  (!pd.slice || pd.slice->count(store))) {
+                for (Value *oi : delta) {
+                  send({y, oi, {}});
+                }
+              }
+            }
+
+          } else if (LoadInst *load = dyn_cast<LoadInst>(user)) {
+            if (load->getPointerOperand() == n &&
+                (!pd.slice || pd.slice->count(load))) {
+              for (Value *oi : delta) {
+                send({oi, load, {}});
+              }
+            }
+          }
+        }
+      }
+
+      if (++processed == FLUSH_EVERY)
+        flush();
+    }
+    flush();
+  }
+}
+
+// Same contract as solve(), but spreads the work of one function over
+// nthreads threads. The shards are merged back into localdata afterwards.
+bool solveParallel(LocalData &localdata, int nthreads,
+                   const Budget &budget = Budget()) {
+  ParallelData pd(nthreads);
+  pd.budget = budget;
+  if (localdata.sliced)
+    pd.slice = &localdata.slice;
+  for (auto &[s, targets] : localdata.PFG) {
+    pd.shards[pd.owner(s)].data.PFG[s] = std::move(targets);
+  }
+  localdata.PFG.clear();
+  auto &worklist = localdata.worklist;
+  while (!worklist.empty()) {
+    auto &[n, pts] = worklist.front();
+    pd.shards[pd.owner(n)].inbox.push_back({n, nullptr, std::move(pts)});
+    pd.pending++;
+    worklist.pop();
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(nthreads);
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back(shardSolve, std::ref(pd), i);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (auto &shard : pd.shards) {
+    for (auto &[n, pts] : shard.data.pt)
+      localdata.pt[n] = std::move(pts);
+    for (auto &[s, targets] : shard.data.PFG)
+      localdata.PFG[s] = std::move(targets);
+  }
+  return !pd.stop;
+}
+
+// Pointer-relevance slicing (--slice). A value takes part in solving only
+// if it may point to something, going forward from the allocas/geps, and may
+// affect a query, going backward from the queries or, without any, from the
+// pointer operands of all loads and stores. Non-pointer values thus drop out
+// unless they carry a pointer between two pointers (ptrtoint/inttoptr), and
+// so does everything in blocks unreachable from the entry. Loads and stores
+// outside the slice add no edges.
+// What is preserved: every value in the slice gets the points-to set that
+// the unsliced analysis gives it once the blocks unreachable from the entry
+// are deleted. Unreachable loads and stores are dropped, so a kept value can
+// only lose objects that such code alone would have added. Values outside
+// the slice are not solved and print with empty sets.
+// Each function is recorded once per analysis run, however many times it
+// was solved for measurement.
+struct SliceStats {
+  std::atomic<size_t> nodes{0}, kept{0};
+  std::atomic<long long> time{0}; // us
+  // sequential --stats only: slicing plus median init + solve with the
+  // slice, and median init + solve without, summed over the functions, in us
+  double slicedTime = 0, wholeTime = 0;
+
+  void reset() {
+    nodes = 0;
+    kept = 0;
+    time = 0;
+    slicedTime = wholeTime = 0;
+  }
+};
+
+SliceStats sliceStats;
+
+void recordSlice(const LocalData &localdata) {
+  if (!localdata.sliced)
+    return;
+  sliceStats.nodes += localdata.sliceNodes;
+  sliceStats.kept += localdata.slice.size();
+  sliceStats.time += (long long)localdata.sliceTime;
+}
+
+void printSliceStats() {
+  size_t nodes = sliceStats.nodes, kept = sliceStats.kept;
+  outs() << "Slice: " << kept << " of " << nodes << " node(s) kept ("
+         << format("%.1f%%", nodes ? 100.0 * kept / nodes : 0.0)
+         << "), slicing time " << sliceStats.time << " us\n";
+  if (sliceStats.wholeTime > 0)
+    outs() << "Slicing, init and solve (median): "
+           << (long long)sliceStats.slicedTime << " us sliced, "
+           << (long long)sliceStats.wholeTime << " us unsliced ("
+           << format("%.1f%%", 100 * (1 - sliceStats.slicedTime /
+                                              sliceStats.wholeTime))
+           << " less)\n";
+}
+
+// Calls fn on the copy sources of v, as initialize() sees them.
+template <typename Fn> void forEachSource(Value *v, Fn fn) {
+  if (auto *phi = dyn_cast<PHINode>(v)) {
+    for (Value *val : phi->incoming_values())
+      fn(val);
+  } else if (auto *select = dyn_cast<SelectInst>(v)) {
+    fn(select->getTrueValue());
+    fn(select->getFalseValue());
+  } else if (auto *cast = dyn_cast<CastInst>(v)) {
+    fn(cast->getOperand(0));
+  }
+}
+
+void computeSlice(Function &func, const std::vector<Value *> &queries,
+                  std::unordered_set<Value *> &slice) {
+  std::unordered_set<BasicBlock *> reachable;
+  std::vector<BasicBlock *> stack = {&func.getEntryBlock()};
+  while (!stack.empty()) {
+    BasicBlock *BB = stack.back();
+    stack.pop_back();
+    if (!reachable.insert(BB).second)
+      continue;
+    for (BasicBlock *succ : successors(BB))
+      stack.push_back(succ);
+  }
+  auto live = [&](Value *v) {
+    if (isa<Argument>(v))
+      return true;
+    auto *inst = dyn_cast<Instruction>(v);
+    return inst && reachable.count(inst->getParent());
+  };
+
+  std::vector<LoadInst *> loads;
+  std::vector<StoreInst *> stores;
+  std::unordered_set<Value *> forward;
+  std::vector<Value *> work;
+  auto addForward = [&](Value *v) {
+    if (live(v) && forward.insert(v).second)
+      work.push_back(v);
+  };
+  for (auto &BB : func) {
+    if (!reachable.count(&BB))
+      continue;
+    for (auto &inst : BB) {
+      if (isa<AllocaInst>(&inst) || isa<GetElementPtrInst>(&inst))
+        addForward(&inst);
+      else if (auto *load = dyn_cast<LoadInst>(&inst))
+        loads.push_back(load);
+      else if (auto *store = dyn_cast<StoreInst>(&inst))
+        stores.push_back(store);
+    }
+  }
+
+  // An alloca/gep node also holds the contents of its object, starting with
+  // itself, so a load through a forward pointer always yields something.
+  while (!work.empty()) {
+    Value *v = work.back();
+    work.pop_back();
+    for (User *user : v->users()) {
+      if (auto *load = dyn_cast<LoadInst>(user)) {
+        if (load->getPointerOperand() == v)
+          addForward(load);
+      } else if (!isa<StoreInst>(user)) {
+        forEachSource(user, [&](Value *src) {
+          if (src == v)
+            addForward(user);
+        });
+      }
+    }
+  }
+
+  // Values outside forward have empty points-to sets, so the backward walk
+  // can stop at them.
+  auto addBackward = [&](Value *v) {
+    if (forward.count(v) && slice.insert(v).second)
+      work.push_back(v);
+  };
+  if (queries.empty()) {
+    for (auto *load : loads)
+      addBackward(load->getPointerOperand());
+    for (auto *store : stores)
+      addBackward(store->getPointerOperand());
+  } else {
+    for (Value *q : queries)
+      addBackward(q);
+  }
+  bool stored = false;
+  while (!work.empty()) {
+    Value *v = work.back();
+    work.pop_back();
+    forEachSource(v, addBackward);
+    if (auto *load = dyn_cast<LoadInst>(v))
+      addBackward(load->getPointerOperand());
+    // an alloca/gep is also the object it points to, so its contents and
+    // what a load reads depend on every store that may write objects
+    if (isa<LoadInst>(v) || isa<AllocaInst>(v) || isa<GetElementPtrInst>(v)) {
+      if (!stored) {
+        stored = true;
+        for (auto *store : stores) {
+          addBackward(store->getValueOperand());
+          addBackward(store->getPointerOperand());
+          // the solver skips stores outside the slice, just like loads
+          if (forward.count(store->getValueOperand()) &&
+              forward.count(store->getPointerOperand()))
+            slice.insert(store);
+        }
+      }
+    }
+  }
+}
+
+// Computes the slice of func into localdata. The caller records it in
+// sliceStats.
+void sliceFunction(Function &func, LocalData &localdata) {
+  auto begin = Clock::now();
+  std::vector<Value *> queries;
+  for (auto &[fname, vname] : opts.queries) {
+    if (func.getName() != fname)
+      continue;
+    for (auto &arg : func.args())
+      if (arg.getName() == vname)
+        queries.push_back(&arg);
+    for (auto &BB : func)
+      for (auto &inst : BB)
+        if (inst.getName() == vname)
+          queries.push_back(&inst);
+  }
+  localdata.sliced = true;
+  // with queries given, a function without any has nothing to solve
+  if (opts.queries.empty() || !queries.empty())
+    computeSlice(func, queries, localdata.slice);
+
+  localdata.sliceNodes = func.arg_size();
+  for (auto &BB : func)
+    localdata.sliceNodes += BB.size();
+  localdata.sliceTime =
+      std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+}
+
+// initialize(), restricted to the slice of func with --slice.
+void prepare(Function &func, LocalData &localdata) {
+  if (opts.slice)
+    sliceFunction(func, localdata);
+  initialize(func, localdata);
+}
+
+// Steensgaard-style unification (unify.h) used to over-approximate functions
+// that ran out of budget. Follows the same node model as the solver: an
+// alloca/gep is both a pointer and the object it points to.
+struct UnifyData {
+  std::unordered_map<Value *, unsigned> id;
+  UnionFind uf;
+};
+
+unsigned ufNode(Value *v, UnifyData &ud) {
+  auto it = ud.id.find(v);
+  if (it != ud.id.end())
+    return it->second;
+  unsigned n = ud.uf.makeNode();
+  ud.id.emplace(v, n);
+  return n;
+}
+
+void fallback(Function &func, LocalData &localdata) {
+  UnifyData ud;
+  auto &uf = ud.uf;
+  auto copy = [&](Value *s, Value *t) {
+    if (isa<Instruction>(s) || isa<Argument>(s))
+      uf.join(uf.makePointee(ufNode(s, ud)), uf.makePointee(ufNode(t, ud)));
+  };
+  std::vector<Value *> objects;
+  for (auto &BB : func) {
+    for (auto &inst : BB) {
+      if (isa<AllocaInst>(&inst) || isa<GetElementPtrInst>(&inst)) {
+        unsigned o = ufNode(&inst, ud);
+        uf.join(uf.makePointee(o), o);
+        objects.push_back(&inst);
+
+      } else if (auto *phi = dyn_cast<PHINode>(&inst)) {
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+          copy(phi->getIncomingValue(i), phi);
+        }
+
+      } else if (auto *select = dyn_cast<SelectInst>(&inst)) {
+        copy(select->getTrueValue(), select);
+        copy(select->getFalseValue(), select);
+
+      } else if (auto *cast = dyn_cast<CastInst>(&inst)) {
+        copy(cast->getOperand(0), cast);
+
+      } else if (auto *store = dyn_cast<StoreInst>(&inst)) {
+        // [*x = y] -> join(**x, *y)
+        Value *y = store->getValueOperand();
+        if (isa<Instruction>(y) || isa<Argument>(y)) {
+          unsigned x = ufNode(store->getPointerOperand(), ud);
+          uf.join(uf.makePointee(uf.makePointee(x)),
+                  uf.makePointee(ufNode(y, ud)));
+        }
+
+      } else if (auto *load = dyn_cast<LoadInst>(&inst)) {
+        // [y = *x] -> join(*y, **x)
+        unsigned x = ufNode(load->getPointerOperand(), ud);
+        uf.join(uf.makePointee(ufNode(load, ud)),
+                uf.makePointee(uf.makePointee(x)));
+      }
+    }
+  }
+
+  std::unordered_map<unsigned, std::set<Value *>> classObjects;
+  for (Value *o : objects) {
+    classObjects[uf.find(ud.id[o])].insert(o);
+  }
+  auto &pt = localdata.pt;
+  pt.clear();
+  for (auto &[v, n] : ud.id) {
+    unsigned p = uf.pointee(n);
+    if (p == UnionFind::NONE)
+      continue;
+    auto it = classObjects.find(p);
+    if (it != classObjects.end())
+      pt[v] = it->second;
+  }
+  std::queue<std::pair<Value *, std::set<Value *>>>().swap(localdata.worklist);
+}
+
+// Solve within budget; degrade to the unification result if it runs out.
+// Returns true if the function was degraded.
+bool solveBudgeted(Function &func, LocalData &localdata, int nthreads = 1) {
+  bool done = nthreads > 1 ? solveParallel(localdata, nthreads, makeBudget())
+                           : solve(localdata, makeBudget());
+  if (done)
+    return false;
+  fallback(func, localdata);
+  return true;
+}
+
+// Order statistics of repeated timings, in us.
+struct Summary {
+  double median = 0, p95 = 0, min = 0, mean = 0, sd = 0;
+};
+
+Summary summarize(std::vector<double> samples) {
+  Summary sum;
+  size_t n = samples.size();
+  if (n == 0)
+    return sum;
+  std::sort(samples.begin(), samples.end());
+  sum.min = samples[0];
+  sum.median = n % 2 ? samples[n / 2]
+                     : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+  // nearest rank
+  sum.p95 = samples[std::max<size_t>(std::ceil(0.95 * n), 1) - 1];
+  for (double x : samples)
+    sum.mean += x / n;
+  for (double x : samples)
+    sum.sd += (x - sum.mean) * (x - sum.mean);
+  sum.sd = n > 1 ? std::sqrt(sum.sd / (n - 1)) : 0;
+  return sum;
 }
 
 void print(LocalData& localdata) {
@@ -164,8 +829,22 @@ void print(LocalData& localdata) {
   // }
 }
 
+// Where and when a task ran, indexed like the functions of the module.
+struct TaskSpan {
+  Function *func = nullptr;
+  size_t size = 0;
+  int tid = -1; // -1: solved by all threads together
+  Clock::time_point start, end;
+  double wait = 0; // us spent taking the task off the queue
+
+  double time() const {
+    return std::chrono::duration<double, std::micro>(end - start).count();
+  }
+};
+
 void threadedPoints2(std::mutex &Qmutex, std::priority_queue<TaskInfo> &taskQ,
-                      int tid) {
+                      std::vector<char> &degraded,
+                      std::vector<TaskSpan> &spans, int tid) {
   auto start = std::chrono::high_resolution_clock::now();
   int max_time = 0;
   int max_size = 0;
@@ -179,6 +858,7 @@ void threadedPoints2(std::mutex &Qmutex, std::priority_queue<TaskInfo> &taskQ,
     int index;
     Function *func;
     int size;
+    auto wait_start = std::chrono::high_resolution_clock::now();
     {
       std::lock_guard<std::mutex> lock(Qmutex);
       if (taskQ.empty())
@@ -188,16 +868,23 @@ void threadedPoints2(std::mutex &Qmutex, std::priority_queue<TaskInfo> &taskQ,
       size = taskQ.top().size;
       taskQ.pop();
     }
-#ifdef PRINT_STATS
     auto sub_start = std::chrono::high_resolution_clock::now();
-#endif
 
     LocalData localdata;
-    initialize(*func, localdata);
-    solve(localdata);
+    prepare(*func, localdata);
+    degraded[index] = solveBudgeted(*func, localdata);
+    recordSlice(localdata);
 
-#ifdef PRINT_STATS
     auto sub_end = std::chrono::high_resolution_clock::now();
+    auto &span = spans[index];
+    span.func = func;
+    span.size = size;
+    span.tid = tid;
+    span.start = sub_start;
+    span.end = sub_end;
+    span.wait =
+        std::chrono::duration<double, std::micro>(sub_start - wait_start)
+            .count();
     auto sub_duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(sub_end -
         sub_start);
@@ -211,18 +898,21 @@ void threadedPoints2(std::mutex &Qmutex, std::priority_queue<TaskInfo> &taskQ,
     total_size_sq += size * size;
     total_time += time;
     total_time_sq += time * time;
-#endif
   }
 
-#ifdef PRINT_STATS
+  // the sweep only reports the aggregate
+  if (!opts.stats || opts.sweep)
+    return;
   auto end = std::chrono::high_resolution_clock::now();
   auto duration =
       std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
 
-  int mean_size = total_size / task_count;
-  int var_size = (total_size_sq / task_count) - (mean_size * mean_size);
-  int mean_time = total_time / task_count;
-  int var_time = (total_time_sq / task_count) - (mean_time * mean_time);
+  // a thread may find the queue already drained
+  int divisor = task_count ? task_count : 1;
+  int mean_size = total_size / divisor;
+  int var_size = (total_size_sq / divisor) - (mean_size * mean_size);
+  int mean_time = total_time / divisor;
+  int var_time = (total_time_sq / divisor) - (mean_time * mean_time);
 
   {
     std::lock_guard<std::mutex> lock(outsmtx);
@@ -235,103 +925,789 @@ void threadedPoints2(std::mutex &Qmutex, std::priority_queue<TaskInfo> &taskQ,
     outs() << "Task time mean:\t" << mean_time << ", var:\t" << var_time
            << ", std dev:\t" << (int)std::sqrt(var_time) << "\n";
   }
-#endif
 }
 
-int main(int argc, char *argv[]) {
-  InitLLVM X(argc, argv);
-  if (argc < 2) {
-    outs() << "Expect IR filename\n";
-    exit(1);
+// Load balance of the pool. Pool tasks are independent, so the longest one
+// is the critical path and max(longest, total / nthreads) bounds the makespan
+// from below.
+void printTimelineSummary(const std::vector<TaskSpan> &spans,
+                          Clock::time_point pool_start,
+                          Clock::time_point pool_end, int nthreads) {
+  auto us = [](Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+  };
+  double makespan = us(pool_end - pool_start);
+  std::vector<double> busy(nthreads, 0), wait(nthreads, 0);
+  std::vector<Clock::time_point> finish(nthreads, pool_start);
+  const TaskSpan *longest = nullptr;
+  double parallel_time = 0;
+  for (auto &span : spans) {
+    if (!span.func)
+      continue;
+    if (span.tid < 0) {
+      parallel_time += span.time();
+      continue;
+    }
+    busy[span.tid] += span.time();
+    wait[span.tid] += span.wait;
+    finish[span.tid] = std::max(finish[span.tid], span.end);
+    if (!longest || span.time() > longest->time())
+      longest = &span;
   }
-  LLVMContext context;
-  SMDiagnostic smd;
-  char *filename = argv[1];
-  std::unique_ptr<Module> module = parseIRFile(filename, smd, context);
-  if (!module) {
-    outs() << "Cannot parse IR file\n";
-    smd.print(filename, outs());
-    exit(1);
+
+  double total = 0, max_busy = 0;
+  for (int t = 0; t < nthreads; ++t) {
+    total += busy[t];
+    max_busy = std::max(max_busy, busy[t]);
   }
+  double mean_busy = total / nthreads;
+  double bound = std::max(longest ? longest->time() : 0.0, mean_busy);
+  auto first_idle = *std::min_element(finish.begin(), finish.end());
 
-  outs() << "Intra-Procedural Analysis" << "\n";
-  outs() << module->getFunctionList().size() << " function(s)\n";
-  auto start = std::chrono::high_resolution_clock::now();
+  std::lock_guard<std::mutex> lock(outsmtx);
+  outs() << "\nTimeline summary\n";
+  if (parallel_time > 0)
+    outs() << "Parallel tasks:\t" << (long long)parallel_time << " us\n";
+  outs() << "Pool makespan:\t" << (long long)makespan << " us\n";
+  for (int t = 0; t < nthreads; ++t) {
+    outs() << "Thread " << t << "\tbusy:\t" << (long long)busy[t]
+           << " us, queue wait:\t" << (long long)wait[t]
+           << " us, utilization:\t"
+           << format("%.1f%%", makespan > 0 ? 100 * busy[t] / makespan : 0)
+           << "\n";
+  }
+  outs() << "Load imbalance (max/mean busy):\t"
+         << format("%.2f", mean_busy > 0 ? max_busy / mean_busy : 1) << "\n";
+  if (longest)
+    outs() << "Critical path:\t" << (long long)longest->time() << " us in "
+           << longest->func->getName() << " with " << longest->size
+           << " BBs\n";
+  outs() << "Makespan lower bound:\t" << (long long)bound << " us ("
+         << format("%.1f%%", makespan > 0 ? 100 * bound / makespan : 100)
+         << " of makespan)\n";
+  outs() << "Straggler tail:\t" << (long long)us(pool_end - first_idle)
+         << " us after the first thread went idle\n";
+}
 
-#ifndef NTHREADS
-#define NTHREADS 16
-#endif
+// Writes the spans in the Chrome trace event format, with times relative to
+// origin. Tasks solved by all threads get a row of their own.
+bool writeTimeline(const std::string &filename,
+                   const std::vector<TaskSpan> &spans,
+                   Clock::time_point origin, int nthreads) {
+  std::error_code ec;
+  raw_fd_ostream os(filename, ec);
+  if (ec)
+    return false;
+  auto us = [&](Clock::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - origin).count();
+  };
+  json::OStream J(os);
+  J.object([&] {
+    J.attribute("displayTimeUnit", "ms");
+    J.attributeArray("traceEvents", [&] {
+      for (int t = 0; t <= nthreads; ++t) {
+        J.object([&] {
+          J.attribute("name", "thread_name");
+          J.attribute("ph", "M");
+          J.attribute("pid", 0);
+          J.attribute("tid", t);
+          J.attributeObject("args", [&] {
+            J.attribute("name", t < nthreads ? "worker " + std::to_string(t)
+                                             : std::string("all threads"));
+          });
+        });
+      }
+      for (auto &span : spans) {
+        if (!span.func)
+          continue;
+        int tid = span.tid < 0 ? nthreads : span.tid;
+        std::string name = span.func->getName().str();
+        if (!json::isUTF8(name))
+          name = json::fixUTF8(name);
+        if (span.wait > 0) {
+          J.object([&] {
+            J.attribute("name", "queue");
+            J.attribute("cat", "wait");
+            J.attribute("ph", "X");
+            J.attribute("ts", us(span.start) - span.wait);
+            J.attribute("dur", span.wait);
+            J.attribute("pid", 0);
+            J.attribute("tid", tid);
+          });
+        }
+        J.object([&] {
+          J.attribute("name", name);
+          J.attribute("cat", "task");
+          J.attribute("ph", "X");
+          J.attribute("ts", us(span.start));
+          J.attribute("dur", span.time());
+          J.attribute("pid", 0);
+          J.attribute("tid", tid);
+          J.attributeObject("args", [&] {
+            J.attribute("size", (int64_t)span.size);
+            J.attribute("queue_wait_us", span.wait);
+          });
+        });
+      }
+    });
+  });
+  return true;
+}
 
-// #define CONCURRENT
-#ifdef CONCURRENT
-  outs() << "Concurrent mode\n";
+// Arms the whole-program budget, if any, from start.
+void startProgramClock(Clock::time_point start) {
+  programTimed = opts.totalTimeBudget > 0;
+  programDeadline = start + std::chrono::microseconds(opts.totalTimeBudget);
+}
+
+struct PoolRun {
+  std::vector<TaskSpan> spans;
+  std::vector<double> costs; // predicted, by function index
+  Clock::time_point pool_start, pool_end;
+};
+
+PoolRun runConcurrent(Module &module, int nthreads, const CostModel &model,
+                      std::vector<char> &degraded) {
+  // Longest-processing-time-first: the queue pops the highest cost first.
   std::priority_queue<TaskInfo> taskQ;
-  for (auto [i, func] : enumerate(*module)) {
+  std::vector<TaskInfo> bigTasks;
+  PoolRun run;
+  run.spans.resize(degraded.size());
+  run.costs.resize(degraded.size());
+  int i = -1;
+  for (auto &func : module) {
+    ++i;
     if (func.isDeclaration())
       continue;
-    taskQ.push({&func, func.size(), (int)i});
+    TaskInfo task = {&func, func.size(), i, model.predict(func)};
+    run.costs[i] = task.cost;
+    if (func.size() >= opts.parallelThreshold)
+      bigTasks.push_back(task);
+    else
+      taskQ.push(task);
+  }
+
+  // Oversized functions would dominate the critical path on one thread, so
+  // solve them one at a time with every thread before the pool starts.
+  std::sort(bigTasks.rbegin(), bigTasks.rend());
+  for (auto &task : bigTasks) {
+    auto sub_start = std::chrono::high_resolution_clock::now();
+    LocalData localdata;
+    prepare(*task.func, localdata);
+    degraded[task.index] = solveBudgeted(*task.func, localdata, nthreads);
+    recordSlice(localdata);
+    auto sub_end = std::chrono::high_resolution_clock::now();
+    run.spans[task.index] = {task.func, task.size, -1, sub_start, sub_end};
+    if (opts.stats && !opts.sweep) {
+      outs() << "Parallel task " << task.func->getName() << "\ttime:\t"
+             << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    sub_end - sub_start)
+                    .count()
+             << " ms with\t " << task.size << " BBs\n";
+    }
   }
+
+  run.pool_start = std::chrono::high_resolution_clock::now();
   std::mutex Qmutex;
   std::vector<std::thread> threads;
-  threads.reserve(NTHREADS);
-  for (int i = 0; i < NTHREADS; ++i) {
-    threads.emplace_back(threadedPoints2, std::ref(Qmutex), std::ref(taskQ), i);
+  threads.reserve(nthreads);
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back(threadedPoints2, std::ref(Qmutex), std::ref(taskQ),
+                         std::ref(degraded), std::ref(run.spans), i);
   }
   for (auto &t : threads) {
     t.join();
   }
+  run.pool_end = std::chrono::high_resolution_clock::now();
+  return run;
+}
+
+// Compares the costs the pool was scheduled by against what it actually did.
+void reportModel(Module &module, const PoolRun &run, int nthreads) {
+  std::vector<double> poolCosts, actualCosts;
+  double abs_err = 0;
+  int i = -1;
+  for (auto &func : module) {
+    ++i;
+    if (func.isDeclaration() || func.size() >= opts.parallelThreshold)
+      continue;
+    double predicted = run.costs[i];
+    poolCosts.push_back(predicted);
+    actualCosts.push_back(run.spans[i].time());
+    abs_err += std::abs(predicted - run.spans[i].time());
+  }
+  std::sort(poolCosts.rbegin(), poolCosts.rend());
+  std::sort(actualCosts.rbegin(), actualCosts.rend());
+  outs() << "Predicted makespan: "
+         << (long long)simulateMakespan(poolCosts, nthreads) << " us\n";
+  outs() << "Actual makespan: "
+         << std::chrono::duration_cast<std::chrono::microseconds>(
+                run.pool_end - run.pool_start)
+                .count()
+         << " us (LPT on measured times: "
+         << (long long)simulateMakespan(actualCosts, nthreads) << " us)\n";
+  if (!actualCosts.empty())
+    outs() << "Mean abs prediction error: "
+           << (long long)(abs_err / actualCosts.size()) << " us\n";
+}
 
-#else
-  outs() << "Sequential mode\n";
+// Runs the concurrent mode on the already loaded module with 1, 2, 4, ...
+// and maxThreads threads. Utilization is busy time over the pool makespan.
+void sweep(Module &module, int maxThreads, const CostModel &model) {
+  std::vector<int> counts;
+  for (int t = 1; t < maxThreads; t *= 2)
+    counts.push_back(t);
+  counts.push_back(maxThreads);
+  std::vector<char> degraded(module.getFunctionList().size(), 0);
+  for (int r = 0; r < opts.warmup; ++r) {
+    startProgramClock(Clock::now());
+    runConcurrent(module, maxThreads, model, degraded);
+  }
 
-// #define CSV
-#ifdef CSV
-  std::string csvname = std::string(argv[1]) + ".csv";
-  std::ofstream csv(csvname);
-  csv << "name,size,inum,time(us)\n";
-#ifndef RUN_COUNT
-#define RUN_COUNT 1
-#endif
-#endif
+  outs() << "Thread sweep\n";
+  outs() << right_justify("threads", 8) << right_justify("time(us)", 13)
+         << right_justify("speedup", 9) << right_justify("efficiency", 11)
+         << right_justify("util", 10) << right_justify("min util", 10)
+         << "\n";
+  double base = 0;
+  for (int nthreads : counts) {
+    sliceStats.reset();
+    auto start = Clock::now();
+    startProgramClock(start);
+    PoolRun run = runConcurrent(module, nthreads, model, degraded);
+    double time =
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count();
+    double makespan = std::chrono::duration<double, std::micro>(
+                          run.pool_end - run.pool_start)
+                          .count();
+    std::vector<double> busy(nthreads, 0);
+    for (auto &span : run.spans)
+      if (span.func && span.tid >= 0)
+        busy[span.tid] += span.time();
+    std::vector<double> util;
+    for (double b : busy)
+      util.push_back(makespan > 0 ? 100 * b / makespan : 0);
+    double mean_util = 0;
+    for (double u : util)
+      mean_util += u / nthreads;
 
-  for (auto &func : *module) {
+    if (nthreads == 1)
+      base = time;
+    double speedup = time > 0 ? base / time : 0;
+    outs() << format("%8d %12lld %8.2f %9.1f%% %8.1f%% %8.1f%%\n", nthreads,
+                     (long long)time, speedup, 100 * speedup / nthreads,
+                     mean_util, *std::min_element(util.begin(), util.end()));
+    if (opts.stats) {
+      outs() << "\tper thread:";
+      for (double u : util)
+        outs() << format(" %.0f%%", u);
+      outs() << "\n";
+    }
+  }
+  if (opts.slice)
+    printSliceStats();
+}
+
+void runSequential(Module &module, const std::string &filename,
+                   std::vector<char> &degraded) {
+  // time(us) is the median total time; p2-fit reads it as the target and
+  // skips the other measured columns.
+  const char *phases[] = {"init", "solve", "total"};
+  std::ofstream csv;
+  if (opts.csv) {
+    csv.open(filename + ".csv");
+    csv << "name,size,inum,time(us),degraded";
+    for (size_t f = 2; f < featureNames.size(); ++f)
+      csv << "," << featureNames[f];
+    csv << ",runs";
+    for (const char *phase : phases)
+      for (const char *stat : {"median", "p95", "min", "mean", "sd"})
+        csv << "," << phase << "_" << stat << "(us)";
+    csv << ",ops_pushes,ops_pops,ops_unions,ops_edges\n";
+    outs() << "Runs per function: " << opts.runs << " after " << opts.warmup
+           << " warm-up run(s)\n";
+  }
+  int warmup = opts.csv ? opts.warmup : 0;
+  int runs = opts.csv ? opts.runs : 1;
+
+  int i = -1;
+  for (auto &func : module) {
+    ++i;
     if (func.isDeclaration())
       continue;
-#ifdef CSV
-    std::string fname = func.getName().str();
-    size_t fsize = func.size();
-    int instNum = 0;
-    for (BasicBlock &BB : func) {
-      instNum += BB.size();
-    }
-    int tftime = 0;
-    for (int r = 0; r < RUN_COUNT; ++r) {
+    // the slice is computed once, outside the measured runs
+    LocalData sliced;
+    if (opts.slice)
+      sliceFunction(func, sliced);
+    LocalData localdata;
+    std::vector<double> times[3];
+    for (int r = -warmup; r < runs; ++r) {
+      localdata = LocalData();
+      localdata.sliced = sliced.sliced;
+      localdata.slice = sliced.slice;
       auto fstart = std::chrono::high_resolution_clock::now();
-#endif
+      initialize(func, localdata);
+      auto fmid = std::chrono::high_resolution_clock::now();
+      degraded[i] = solveBudgeted(func, localdata);
+      auto fend = std::chrono::high_resolution_clock::now();
+      if (r < 0)
+        continue;
+      auto us = [](Clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+      };
+      times[0].push_back(us(fmid - fstart));
+      times[1].push_back(us(fend - fmid));
+      times[2].push_back(us(fend - fstart));
+    }
+
+    if (opts.slice) {
+      recordSlice(sliced);
+      sliceStats.slicedTime += sliced.sliceTime + summarize(times[2]).median;
+    }
+
+    if (opts.csv) {
+      auto features = computeFeatures(func);
+      Summary stats[3];
+      for (int p = 0; p < 3; ++p)
+        stats[p] = summarize(times[p]);
+      csv << func.getName().str() << "," << (size_t)features[0] << ","
+          << (int)features[1] << "," << (long long)stats[2].median << ","
+          << (int)degraded[i];
+      for (size_t f = 2; f < features.size(); ++f)
+        csv << "," << features[f];
+      csv << "," << runs;
+      for (auto &st : stats)
+        csv << "," << st.median << "," << st.p95 << "," << st.min << ","
+            << st.mean << "," << st.sd;
+      auto &ops = localdata.ops;
+      csv << "," << ops.pushes << "," << ops.pops << "," << ops.unions << ","
+          << ops.edges << "\n";
+    }
+
+    if (opts.printResults) {
+      outs() << "\nFunction: " << func.getName() << "\n";
+      print(localdata);
+      outs() << "******************************** " << func.getName() << "\n";
+    }
+  }
+}
+
+// With --slice --stats: solves every function again without the slice, with
+// the same warm-up and runs as runSequential(), for the comparison in
+// printSliceStats(). Runs after the analysis so it is not in its time.
+void compareUnsliced(Module &module) {
+  int warmup = opts.csv ? opts.warmup : 0;
+  int runs = opts.csv ? opts.runs : 1;
+  startProgramClock(Clock::now());
+  for (auto &func : module) {
+    if (func.isDeclaration())
+      continue;
+    std::vector<double> times;
+    for (int r = -warmup; r < runs; ++r) {
       LocalData localdata;
+      auto fstart = std::chrono::high_resolution_clock::now();
       initialize(func, localdata);
-      solve(localdata);
-#ifdef CSV
+      solveBudgeted(func, localdata);
       auto fend = std::chrono::high_resolution_clock::now();
-      auto ftime =
-          std::chrono::duration_cast<std::chrono::microseconds>(fend - fstart)
+      if (r >= 0)
+        times.push_back(
+            std::chrono::duration<double, std::micro>(fend - fstart).count());
+    }
+    sliceStats.wholeTime += summarize(times).median;
+  }
+}
+
+// Batch mode (--batch): many IR files in one process. Workers parse files,
+// each into its own LLVMContext, and queue their functions in one shared
+// pool; a worker parses the next file only while fewer tasks than threads
+// are queued, so few modules are alive at a time. A module is freed as soon
+// as its last function is solved.
+struct BatchFile {
+  std::string path;
+  std::unique_ptr<LLVMContext> context;
+  std::unique_ptr<Module> module;
+  std::string error;
+  size_t functions = 0;
+  int degraded = 0;
+  int remaining = 0;
+  double parseTime = 0, solveTime = 0; // us
+  Clock::time_point first = Clock::time_point::max(), last;
+
+  BatchFile(const std::string &path) : path(path) {}
+};
+
+struct BatchTask {
+  Function *func;
+  BatchFile *file;
+  double cost;
+
+  bool operator<(const BatchTask &rhs) const { return cost < rhs.cost; }
+};
+
+struct BatchQueue {
+  std::vector<BatchFile> files;
+  CostModel model;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::priority_queue<BatchTask> tasks;
+  size_t nextFile = 0;
+  int parsing = 0;
+};
+
+// Reads the .ll/.bc files under a directory, or the paths listed one per
+// line in a file.
+bool collectBatch(const std::string &path, std::vector<BatchFile> &files) {
+  if (sys::fs::is_directory(path)) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (sys::fs::recursive_directory_iterator it(path, ec), end;
+         it != end && !ec; it.increment(ec)) {
+      StringRef ext = sys::path::extension(it->path());
+      if (ext == ".ll" || ext == ".bc")
+        paths.push_back(it->path());
+    }
+    if (ec)
+      return false;
+    std::sort(paths.begin(), paths.end());
+    for (auto &p : paths)
+      files.emplace_back(p);
+    return true;
+  }
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    StringRef p = StringRef(line).trim();
+    if (!p.empty() && !p.startswith("#"))
+      files.emplace_back(p.str());
+  }
+  return true;
+}
+
+void parseBatchFile(BatchFile &file) {
+  auto start = Clock::now();
+  file.context = std::make_unique<LLVMContext>();
+  SMDiagnostic smd;
+  file.module = parseIRFile(file.path, smd, *file.context);
+  if (!file.module) {
+    file.error = smd.getMessage().str();
+    file.context.reset();
+  }
+  file.parseTime =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+void batchWorker(BatchQueue &q, int nthreads) {
+  std::unique_lock<std::mutex> lock(q.mtx);
+  while (true) {
+    if (q.nextFile < q.files.size() && (int)q.tasks.size() < nthreads) {
+      BatchFile &file = q.files[q.nextFile++];
+      q.parsing++;
+      lock.unlock();
+      parseBatchFile(file);
+      std::vector<BatchTask> tasks;
+      if (file.module) {
+        for (auto &func : *file.module)
+          if (!func.isDeclaration())
+            tasks.push_back({&func, &file, q.model.predict(func)});
+      }
+      file.functions = file.remaining = tasks.size();
+      if (tasks.empty()) {
+        file.module.reset();
+        file.context.reset();
+      }
+      lock.lock();
+      for (auto &task : tasks)
+        q.tasks.push(task);
+      q.parsing--;
+      q.cv.notify_all();
+      continue;
+    }
+
+    if (!q.tasks.empty()) {
+      BatchTask task = q.tasks.top();
+      q.tasks.pop();
+      lock.unlock();
+      auto sub_start = Clock::now();
+      LocalData localdata;
+      prepare(*task.func, localdata);
+      bool degraded = solveBudgeted(*task.func, localdata);
+      recordSlice(localdata);
+      auto sub_end = Clock::now();
+      lock.lock();
+      BatchFile &file = *task.file;
+      file.degraded += degraded;
+      file.solveTime +=
+          std::chrono::duration<double, std::micro>(sub_end - sub_start)
               .count();
-      tftime += ftime;
+      file.first = std::min(file.first, sub_start);
+      file.last = std::max(file.last, sub_end);
+      if (--file.remaining == 0) {
+        lock.unlock();
+        file.module.reset();
+        file.context.reset();
+        lock.lock();
+      }
+      continue;
+    }
+
+    if (q.nextFile == q.files.size() && q.parsing == 0)
+      break;
+    q.cv.wait(lock);
+  }
+}
+
+int runBatch(const std::string &path, const std::string &outname,
+             const CostModel &model) {
+  BatchQueue q;
+  q.model = model;
+  if (!collectBatch(path, q.files)) {
+    outs() << "Cannot read batch " << path << "\n";
+    return 1;
+  }
+  outs() << "Batch mode, " << q.files.size() << " file(s), "
+         << opts.nthreads << " thread(s)\n";
+
+  auto start = Clock::now();
+  startProgramClock(start);
+  std::vector<std::thread> threads;
+  threads.reserve(opts.nthreads);
+  for (int i = 0; i < opts.nthreads; ++i)
+    threads.emplace_back(batchWorker, std::ref(q), opts.nthreads);
+  for (auto &t : threads)
+    t.join();
+  double wall =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+  std::ofstream out(outname);
+  out << "file,status,functions,parse(us),solve(us),span(us),degraded\n";
+  size_t failed = 0, functions = 0, degraded = 0;
+  double parseTotal = 0, solveTotal = 0;
+  for (auto &file : q.files) {
+    // the span runs from the first task start to the last task end
+    double span =
+        file.functions ? std::chrono::duration<double, std::micro>(
+                             file.last - file.first)
+                             .count()
+                       : 0;
+    std::string status = file.error.empty() ? "ok" : file.error;
+    std::replace(status.begin(), status.end(), ',', ';');
+    std::replace(status.begin(), status.end(), '\n', ' ');
+    out << file.path << "," << status << "," << file.functions << ","
+        << (long long)file.parseTime << "," << (long long)file.solveTime
+        << "," << (long long)span << "," << file.degraded << "\n";
+    if (!file.error.empty()) {
+      failed++;
+      outs() << "Cannot parse " << file.path << ": " << file.error << "\n";
+    }
+    functions += file.functions;
+    degraded += file.degraded;
+    parseTotal += file.parseTime;
+    solveTotal += file.solveTime;
+  }
+
+  outs() << "Results: " << outname << "\n";
+  outs() << q.files.size() - failed << " file(s) analyzed, " << failed
+         << " failed, " << functions << " function(s)";
+  if (degraded)
+    outs() << ", " << degraded << " degraded";
+  outs() << "\n";
+  outs() << "Parse time: " << (long long)parseTotal
+         << " us, solve time: " << (long long)solveTotal << " us (summed)\n";
+  outs() << "Wall time: " << (long long)wall << " us, "
+         << format("%.1f", wall > 0 ? q.files.size() / (wall / 1e6) : 0.0)
+         << " file(s)/s, pool utilization "
+         << format("%.1f%%", wall > 0 ? 100 * (parseTotal + solveTotal) /
+                                            (wall * opts.nthreads)
+                                      : 0.0)
+         << "\n";
+  return 0;
+}
+
+void usage() {
+  outs() << "Usage: p2 [options] <IR file>\n"
+            "       p2 [options] --batch <directory or file list>\n"
+            "  --threads N              concurrent mode with N threads\n"
+            "  --concurrent             concurrent mode, one thread per core\n"
+            "  --sweep                  time the pool with 1, 2, 4, ... up to\n"
+            "                           --threads threads\n"
+            "  --batch PATH             analyze the .ll/.bc files under a\n"
+            "                           directory or listed in a file,\n"
+            "                           instead of a single IR file\n"
+            "  --batch-out FILE         per-file results of --batch\n"
+            "                           (default p2-batch.csv)\n"
+            "  --stats                  per-thread and load balance\n"
+            "                           statistics\n"
+            "  --timeline               write <IR file>.trace.json\n"
+            "  --model FILE             cost model from p2-fit\n"
+            "  --csv                    write per-function timings to\n"
+            "                           <IR file>.csv (sequential mode)\n"
+            "  --runs N, --warmup N     timed and untimed runs per function\n"
+            "  --print                  print the points-to sets\n"
+            "  --slice                  solve only the pointer-relevant slice\n"
+            "                           of each function\n"
+            "  --query FUNC:VALUE       slice for the named value only; may\n"
+            "                           be repeated, implies --slice\n"
+            "  --func-time-budget US, --func-work-budget POPS,\n"
+            "  --total-time-budget US   degrade to unification past these\n"
+            "  --parallel-threshold N   BBs from which all threads solve a\n"
+            "                           function together\n";
+}
+
+int main(int argc, char *argv[]) {
+  InitLLVM X(argc, argv);
+  const char *filename = nullptr;
+  const char *batchPath = nullptr;
+  const char *batchOut = "p2-batch.csv";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--concurrent") {
+      opts.concurrent = true;
+    } else if (arg == "--threads" && hasValue) {
+      opts.concurrent = true;
+      opts.nthreads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--sweep") {
+      opts.sweep = true;
+    } else if (arg == "--batch" && hasValue) {
+      batchPath = argv[++i];
+    } else if (arg == "--batch-out" && hasValue) {
+      batchOut = argv[++i];
+    } else if (arg == "--stats") {
+      opts.stats = true;
+    } else if (arg == "--timeline") {
+      opts.timeline = true;
+    } else if (arg == "--model" && hasValue) {
+      opts.modelFile = argv[++i];
+    } else if (arg == "--csv") {
+      opts.csv = true;
+    } else if (arg == "--runs" && hasValue) {
+      opts.runs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--warmup" && hasValue) {
+      opts.warmup = std::max(0, std::atoi(argv[++i]));
+    } else if (arg == "--print") {
+      opts.printResults = true;
+    } else if (arg == "--slice") {
+      opts.slice = true;
+    } else if (arg == "--query" && hasValue) {
+      StringRef query = argv[++i];
+      auto [fname, vname] = query.split(':');
+      if (vname.empty()) {
+        outs() << "Expect --query FUNC:VALUE\n";
+        exit(1);
+      }
+      opts.slice = true;
+      opts.queries.push_back({fname.str(), vname.ltrim('%').str()});
+    } else if (arg == "--func-time-budget" && hasValue) {
+      opts.funcTimeBudget = std::atoll(argv[++i]);
+    } else if (arg == "--func-work-budget" && hasValue) {
+      opts.funcWorkBudget = std::atoll(argv[++i]);
+    } else if (arg == "--total-time-budget" && hasValue) {
+      opts.totalTimeBudget = std::atoll(argv[++i]);
+    } else if (arg == "--parallel-threshold" && hasValue) {
+      opts.parallelThreshold = std::atoll(argv[++i]);
+    } else if (arg.rfind("--", 0) == 0 || filename) {
+      outs() << "Unknown argument " << arg << "\n";
+      usage();
+      exit(1);
+    } else {
+      filename = argv[i];
     }
-    tftime /= RUN_COUNT;
-    csv << fname << "," << fsize << "," << instNum << "," << tftime << "\n";
-#endif
+  }
+  if (!filename == !batchPath) {
+    outs() << (batchPath ? "Expect either an IR filename or --batch\n"
+                         : "Expect IR filename\n");
+    usage();
+    exit(1);
+  }
+  if ((opts.concurrent || opts.sweep || batchPath) &&
+      (opts.csv || opts.printResults)) {
+    outs() << "--csv and --print need sequential mode\n";
+    exit(1);
+  }
+  if (batchPath && opts.sweep) {
+    outs() << "--sweep needs a single IR file\n";
+    exit(1);
+  }
+
+  CostModel model;
+  if (opts.modelFile) {
+    if (!loadCostModel(opts.modelFile, model)) {
+      outs() << "Cannot load cost model " << opts.modelFile << "\n";
+      exit(1);
+    }
+    outs() << "Cost model: " << opts.modelFile << "\n";
+  }
+
+  if (batchPath) {
+    int status = runBatch(batchPath, batchOut, model);
+    if (opts.slice)
+      printSliceStats();
+    return status;
+  }
+
+  LLVMContext context;
+  SMDiagnostic smd;
+  std::unique_ptr<Module> module = parseIRFile(filename, smd, context);
+  if (!module) {
+    outs() << "Cannot parse IR file\n";
+    smd.print(filename, outs());
+    exit(1);
+  }
 
-#ifdef PRINT_RESULTS
-    outs() << "\nFunction: " << func.getName() << "\n";
-    print(localdata);
-    outs() << "******************************** " << func.getName() << "\n";
-#endif
+  outs() << "Intra-Procedural Analysis" << "\n";
+  outs() << module->getFunctionList().size() << " function(s)\n";
+
+  if (opts.sweep) {
+    sweep(*module, opts.nthreads, model);
+    return 0;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  startProgramClock(start);
+  std::vector<char> degraded(module->getFunctionList().size(), 0);
+
+  if (opts.concurrent) {
+    outs() << "Concurrent mode, " << opts.nthreads << " thread(s)\n";
+    PoolRun run = runConcurrent(*module, opts.nthreads, model, degraded);
+    if (opts.stats)
+      printTimelineSummary(run.spans, run.pool_start, run.pool_end,
+                           opts.nthreads);
+    if (opts.timeline) {
+      std::string timelinename = std::string(filename) + ".trace.json";
+      if (writeTimeline(timelinename, run.spans, start, opts.nthreads))
+        outs() << "Timeline: " << timelinename << "\n";
+      else
+        outs() << "Cannot write timeline " << timelinename << "\n";
+    }
+    if (model.loaded)
+      reportModel(*module, run, opts.nthreads);
+  } else {
+    outs() << "Sequential mode\n";
+    runSequential(*module, filename, degraded);
   }
-#endif
 
   auto end = std::chrono::high_resolution_clock::now();
   auto duration =
       std::chrono::duration_cast<std::chrono::microseconds>(end - start);
   outs() << "Analysis time: " << duration.count() << " us\n";
-}
\ No newline at end of file
+  if (opts.slice) {
+    if (opts.stats && !opts.concurrent)
+      compareUnsliced(*module);
+    printSliceStats();
+  }
+
+  if (opts.funcTimeBudget || opts.funcWorkBudget || opts.totalTimeBudget) {
+    int count = 0;
+    for (char d : degraded)
+      count += d;
+    outs() << "Degraded function(s): " << count << "\n";
+    int i = 0;
+    for (auto &func : *module) {
+      if (degraded[i++])
+        outs() << "\t" << func.getName() << "\n";
+    }
+  }
+}
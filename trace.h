@@ -0,0 +1,36 @@
+// Binary format of the solver event traces written by p2-inter-dense --trace
+// and read by p2-replay. A trace is the magic string followed by fixed-size
+// events; node IDs are the stable value numbers of the module.
+//
+// The constraint events (ADDR, COPY, LOAD, STORE) are enough to solve the
+// same problem again; the others record what the solver did along the way.
+
+#ifndef POINTS2_TRACE_H
+#define POINTS2_TRACE_H
+
+#include <cstdint>
+
+const char TRACE_MAGIC[] = "P2TR1";
+
+enum TraceKind : uint32_t {
+  TRACE_ADDR,      // a = &b: b in pt(a)
+  TRACE_COPY,      // b = a: edge a -> b from initialize()
+  TRACE_LOAD,      // a = *b
+  TRACE_STORE,     // *a = b
+  TRACE_POP,       // worklist pop of a; n = |pts|, b = |delta|
+  TRACE_EDGE,      // edge a -> b created while solving
+  TRACE_PROPAGATE, // delta of size n pushed from a to b successors
+};
+
+// Set size left out of the trace: with --bdd, counting a set walks its BDD.
+// An empty delta is still recorded as 0.
+const uint32_t TRACE_NO_SIZE = ~0u;
+
+struct TraceEvent {
+  uint32_t kind;
+  uint32_t a;
+  uint32_t b;
+  uint32_t n;
+};
+
+#endif
@@ -0,0 +1,95 @@
+// Union-find for Steensgaard-style unification, shared by p2-steensgaard and
+// the budget fallback of p2. Nodes are dense IDs; each class has at most one
+// pointee class, and merging two classes merges their pointees as well.
+
+#ifndef POINTS2_UNIFY_H
+#define POINTS2_UNIFY_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+class UnionFind {
+public:
+  enum : unsigned { NONE = ~0u };
+
+  size_t size() const { return parent.size(); }
+
+  void reserve(size_t n) {
+    parent.reserve(n);
+    rank.reserve(n);
+    points2.reserve(n);
+  }
+
+  unsigned makeNode() {
+    unsigned n = parent.size();
+    parent.push_back(n);
+    rank.push_back(0);
+    points2.push_back(NONE);
+    return n;
+  }
+
+  unsigned find(unsigned x) {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  }
+
+  // Steensgaard join: merge two classes, then their pointees, and so on.
+  void join(unsigned p, unsigned q) {
+    pending.push_back({p, q});
+    while (!pending.empty()) {
+      auto [x, y] = pending.back();
+      pending.pop_back();
+      x = find(x);
+      y = find(y);
+      if (x == y)
+        continue;
+      if (rank[x] < rank[y])
+        std::swap(x, y);
+      if (rank[x] == rank[y])
+        rank[x]++;
+      parent[y] = x;
+      if (points2[x] == NONE) {
+        points2[x] = points2[y];
+      } else if (points2[y] != NONE) {
+        pending.push_back({points2[x], points2[y]});
+      }
+    }
+  }
+
+  // The pointee class of x's class, or NONE.
+  unsigned pointee(unsigned x) {
+    unsigned p = points2[find(x)];
+    return p == NONE ? NONE : find(p);
+  }
+
+  // The pointee class of x's class, made up as a fresh node if it has none.
+  unsigned makePointee(unsigned x) {
+    x = find(x);
+    if (points2[x] == NONE) {
+      unsigned p = makeNode();
+      points2[x] = p;
+    }
+    return find(points2[x]);
+  }
+
+  // join(*p, q)
+  void joinPointee(unsigned p, unsigned q) {
+    p = find(p);
+    if (points2[p] == NONE)
+      points2[p] = find(q);
+    else
+      join(points2[p], q);
+  }
+
+private:
+  std::vector<unsigned> parent;
+  std::vector<unsigned char> rank;
+  std::vector<unsigned> points2;
+  std::vector<std::pair<unsigned, unsigned>> pending;
+};
+
+#endif